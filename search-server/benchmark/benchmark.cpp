@@ -0,0 +1,340 @@
+// Microbenchmarks of the core index operations on a synthetic corpus.
+// Prints one JSON object to stdout, so runs of different versions can be compared.
+//
+// Usage: benchmark [--sizes 1000,10000,100000] [--queries 1000] [--repetitions 5] [--seed 42]
+
+#include "search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+struct BenchmarkOptions {
+    std::vector<size_t> corpus_sizes = { 1000, 10000, 100000 };
+    size_t query_count = 1000;
+    size_t repetitions = 5;
+    uint32_t seed = 42;
+};
+
+struct CorpusOptions {
+    size_t vocabulary_size = 50000;
+    // Exponent of the Zipf law: the word of rank r occurs with probability proportional to 1 / r^s
+    double zipf_exponent = 1.0;
+    size_t min_words = 20;
+    size_t max_words = 80;
+    // Share of documents repeating the words of an earlier one, found by RemoveDuplicates
+    double duplicate_fraction = 0.05;
+};
+
+struct CorpusDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// Draws word ranks by binary search over the cumulative distribution
+class ZipfGenerator {
+public:
+    ZipfGenerator(size_t size, double exponent) {
+        cumulative_.reserve(size);
+        double sum = 0.0;
+        for (size_t rank = 1; rank <= size; ++rank) {
+            sum += 1.0 / std::pow(static_cast<double>(rank), exponent);
+            cumulative_.push_back(sum);
+        }
+    }
+
+    template <typename Generator>
+    size_t operator()(Generator& generator) const {
+        std::uniform_real_distribution<double> distribution(0.0, cumulative_.back());
+        const auto iter = std::upper_bound(cumulative_.begin(), cumulative_.end(), distribution(generator));
+        return std::min<size_t>(iter - cumulative_.begin(), cumulative_.size() - 1);
+    }
+
+private:
+    std::vector<double> cumulative_;
+};
+
+std::string MakeWord(size_t rank) {
+    return "w"s + std::to_string(rank);
+}
+
+std::vector<CorpusDocument> GenerateCorpus(size_t size, const CorpusOptions& options, std::mt19937& generator) {
+    const ZipfGenerator words(options.vocabulary_size, options.zipf_exponent);
+    std::uniform_int_distribution<size_t> word_count(options.min_words, options.max_words);
+    std::uniform_int_distribution<int> rating(-10, 10);
+    std::uniform_real_distribution<double> share(0.0, 1.0);
+
+    std::vector<CorpusDocument> corpus;
+    corpus.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        CorpusDocument document{ static_cast<int>(i), {}, DocumentStatus::ACTUAL, { rating(generator), rating(generator) } };
+        const double status_share = share(generator);
+        if (status_share < 0.1) {
+            document.status = DocumentStatus::BANNED;
+        }
+        else if (status_share < 0.15) {
+            document.status = DocumentStatus::IRRELEVANT;
+        }
+        if (!corpus.empty() && share(generator) < options.duplicate_fraction) {
+            // Same words in another order
+            std::istringstream original(corpus[generator() % corpus.size()].text);
+            std::vector<std::string> original_words(std::istream_iterator<std::string>(original),
+                std::istream_iterator<std::string>{});
+            std::shuffle(original_words.begin(), original_words.end(), generator);
+            for (const std::string& word : original_words) {
+                document.text += word + " "s;
+            }
+        }
+        else {
+            for (size_t word = word_count(generator); word > 0; --word) {
+                document.text += MakeWord(words(generator)) + " "s;
+            }
+        }
+        corpus.push_back(std::move(document));
+    }
+    return corpus;
+}
+
+// One to four plus words and sometimes a minus word. Ranks are drawn with a flatter
+// law than documents, so queries also hit mid-frequency words.
+std::vector<std::string> GenerateQueries(size_t count, const CorpusOptions& options, std::mt19937& generator) {
+    const ZipfGenerator words(options.vocabulary_size, options.zipf_exponent * 0.7);
+    std::uniform_int_distribution<size_t> word_count(1, 4);
+    std::vector<std::string> queries;
+    queries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string query;
+        for (size_t word = word_count(generator); word > 0; --word) {
+            query += MakeWord(words(generator)) + " "s;
+        }
+        if (generator() % 4 == 0) {
+            query += "-"s + MakeWord(words(generator));
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+struct Measurement {
+    std::string name;
+    size_t corpus_size;
+    // Operations per repetition, the times are per operation
+    size_t operations;
+    double min_ns;
+    double median_ns;
+};
+
+class BenchmarkReport {
+public:
+    explicit BenchmarkReport(const BenchmarkOptions& options)
+        : options_(options) {
+    }
+
+    // prepare runs before every repetition and is not timed, operation runs the measured work once
+    template <typename Prepare, typename Operation>
+    void Measure(const std::string& name, size_t corpus_size, size_t operations, Prepare prepare, Operation operation) {
+        std::vector<double> durations;
+        for (size_t repetition = 0; repetition < options_.repetitions; ++repetition) {
+            prepare();
+            const auto start = std::chrono::steady_clock::now();
+            operation();
+            const auto finish = std::chrono::steady_clock::now();
+            durations.push_back(std::chrono::duration<double, std::nano>(finish - start).count() / std::max<size_t>(operations, 1));
+        }
+        std::sort(durations.begin(), durations.end());
+        measurements_.push_back({ name, corpus_size, operations, durations.front(), durations[durations.size() / 2] });
+    }
+
+    template <typename Operation>
+    void Measure(const std::string& name, size_t corpus_size, size_t operations, Operation operation) {
+        Measure(name, corpus_size, operations, [] {}, operation);
+    }
+
+    void Print(std::ostream& out) const {
+        out << "{\n  \"benchmark\": \"search_server\",\n  \"seed\": "s << options_.seed
+            << ",\n  \"repetitions\": "s << options_.repetitions
+            << ",\n  \"query_count\": "s << options_.query_count
+            << ",\n  \"results\": ["s;
+        bool first = true;
+        for (const Measurement& measurement : measurements_) {
+            out << (first ? "\n"s : ",\n"s) << "    { \"name\": \""s << measurement.name
+                << "\", \"corpus_size\": "s << measurement.corpus_size
+                << ", \"operations\": "s << measurement.operations
+                << ", \"min_ns_per_op\": "s << static_cast<uint64_t>(measurement.min_ns)
+                << ", \"median_ns_per_op\": "s << static_cast<uint64_t>(measurement.median_ns) << " }"s;
+            first = false;
+        }
+        out << "\n  ]\n}"s << std::endl;
+    }
+
+private:
+    const BenchmarkOptions options_;
+    std::vector<Measurement> measurements_;
+};
+
+// Results are summed into a sink, so the compiler keeps the measured calls
+volatile size_t result_sink = 0;
+
+void RunCorpusBenchmarks(size_t corpus_size, const BenchmarkOptions& options, BenchmarkReport& report) {
+    const CorpusOptions corpus_options;
+    std::mt19937 generator(options.seed + static_cast<uint32_t>(corpus_size));
+    const auto corpus = GenerateCorpus(corpus_size, corpus_options, generator);
+    const auto queries = GenerateQueries(options.query_count, corpus_options, generator);
+    const std::string stop_words = "w1 w2 w3"s;
+
+    std::optional<SearchServer> server;
+    report.Measure("add_document"s, corpus_size, corpus.size(), [&] { server.emplace(stop_words); }, [&] {
+        for (const CorpusDocument& document : corpus) {
+            server->AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        });
+
+    const auto measure_queries = [&](const std::string& name, auto search) {
+        report.Measure(name, corpus_size, queries.size(), [&] {
+            for (const std::string& query : queries) {
+                result_sink = result_sink + search(query).size();
+            }
+            });
+    };
+    const auto even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    measure_queries("find_top_documents/seq"s, [&](const std::string& query) {
+        return server->FindTopDocuments(std::execution::seq, query);
+        });
+    measure_queries("find_top_documents/par"s, [&](const std::string& query) {
+        return server->FindTopDocuments(std::execution::par, query);
+        });
+    measure_queries("find_top_documents/dynamic_pruning"s, [&](const std::string& query) {
+        return server->FindTopDocuments(dynamic_pruning, query);
+        });
+    measure_queries("find_top_documents/seq/status"s, [&](const std::string& query) {
+        return server->FindTopDocuments(std::execution::seq, query, DocumentStatus::BANNED);
+        });
+    measure_queries("find_top_documents/par/status"s, [&](const std::string& query) {
+        return server->FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED);
+        });
+    measure_queries("find_top_documents/seq/predicate"s, [&](const std::string& query) {
+        return server->FindTopDocuments(std::execution::seq, query, even);
+        });
+    measure_queries("find_top_documents/par/predicate"s, [&](const std::string& query) {
+        return server->FindTopDocuments(std::execution::par, query, even);
+        });
+
+    // Every query is matched against one document, spread over the corpus
+    const auto measure_matches = [&](const std::string& name, auto match) {
+        report.Measure(name, corpus_size, queries.size(), [&] {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                const int document_id = corpus[i * corpus.size() / queries.size()].id;
+                result_sink = result_sink + std::get<0>(match(queries[i], document_id)).size();
+            }
+            });
+    };
+    measure_matches("match_document/seq"s, [&](const std::string& query, int document_id) {
+        return server->MatchDocument(std::execution::seq, query, document_id);
+        });
+    measure_matches("match_document/par"s, [&](const std::string& query, int document_id) {
+        return server->MatchDocument(std::execution::par, query, document_id);
+        });
+
+    report.Measure("process_queries"s, corpus_size, queries.size(), [&] {
+        result_sink = result_sink + ProcessQueries(*server, queries).size();
+        });
+
+    // The mutating operations work on servers built anew before each repetition
+    std::vector<NewDocument> new_documents;
+    for (const CorpusDocument& document : corpus) {
+        new_documents.push_back({ document.id, document.text, document.status, document.ratings });
+    }
+    std::optional<SearchServer> rebuilt_server;
+    const auto rebuild_server = [&] {
+        rebuilt_server.emplace(stop_words);
+        rebuilt_server->AddDocuments(std::execution::par, new_documents);
+    };
+    std::vector<int> removed_ids;
+    for (size_t i = 0; i < corpus.size(); i += 10) {
+        removed_ids.push_back(corpus[i].id);
+    }
+    report.Measure("remove_document"s, corpus_size, removed_ids.size(), rebuild_server, [&] {
+        for (const int document_id : removed_ids) {
+            rebuilt_server->RemoveDocument(document_id);
+        }
+        });
+
+    // RemoveDuplicates reports every removed document to std::cout, which holds the JSON
+    std::ostringstream duplicates_log;
+    report.Measure("remove_duplicates"s, corpus_size, corpus.size(), rebuild_server, [&] {
+        auto* const stdout_buffer = std::cout.rdbuf(duplicates_log.rdbuf());
+        RemoveDuplicates(*rebuilt_server);
+        std::cout.rdbuf(stdout_buffer);
+        });
+}
+
+std::vector<size_t> ParseSizes(const std::string& text) {
+    std::vector<size_t> sizes;
+    std::istringstream input(text);
+    for (std::string size; std::getline(input, size, ',');) {
+        sizes.push_back(std::stoul(size));
+    }
+    return sizes;
+}
+
+BenchmarkOptions ParseOptions(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i += 2) {
+        const std::string name = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value of "s + name);
+        }
+        const std::string value = argv[i + 1];
+        if (name == "--sizes"s) {
+            options.corpus_sizes = ParseSizes(value);
+        }
+        else if (name == "--queries"s) {
+            options.query_count = std::stoul(value);
+        }
+        else if (name == "--repetitions"s) {
+            options.repetitions = std::max<size_t>(1, std::stoul(value));
+        }
+        else if (name == "--seed"s) {
+            options.seed = static_cast<uint32_t>(std::stoul(value));
+        }
+        else {
+            throw std::invalid_argument("Unknown option "s + name);
+        }
+    }
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const BenchmarkOptions options = ParseOptions(argc, argv);
+        BenchmarkReport report(options);
+        for (const size_t corpus_size : options.corpus_sizes) {
+            RunCorpusBenchmarks(corpus_size, options, report);
+        }
+        report.Print(std::cout);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: "s << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
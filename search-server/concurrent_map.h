@@ -1,31 +1,35 @@
 #pragma once
 
-#include <cstdlib>
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <functional>
 #include <map>
 #include <mutex>
-#include <string>
+#include <optional>
+#include <utility>
 #include <vector>
 
-using namespace std::string_literals;
-
-template <typename Key, typename Value>
+// Hash map for concurrent aggregation. Keys are spread over independently locked
+// stripes, each of them an open-addressing table with linear probing.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
 class ConcurrentMap {
 private:
-    struct Bucket {
+    // Stripes sit on separate cache lines so that their mutexes do not share them
+    struct alignas(64) Stripe {
         std::mutex mutex;
-        std::map<Key, Value> map;
+        std::vector<std::optional<std::pair<Key, Value>>> entries;
+        size_t size = 0;
     };
 
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
-
     struct Access {
         std::lock_guard<std::mutex> guard;
         Value& ref_to_value;
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.map[key]) {
+        Access(const ConcurrentMap& map, const Key& key, uint64_t hash, Stripe& stripe)
+            : guard(stripe.mutex)
+            , ref_to_value(map.FindOrInsert(stripe, key, hash)) {
         }
         Value& operator+=(Value value)
         {
@@ -34,29 +38,158 @@ public:
         }
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count) {
+    explicit ConcurrentMap(size_t stripe_count, const Hash& hash = Hash(), const KeyEqual& key_equal = KeyEqual())
+        : stripes_(std::max<size_t>(stripe_count, 1))
+        , hash_(hash)
+        , key_equal_(key_equal) {
     }
 
+    // The stripe stays locked while the returned Access is alive
     Access operator[](const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return { key, bucket };
+        const uint64_t hash = ComputeHash(key);
+        return { *this, key, hash, GetStripe(hash) };
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (auto& [mutex, map] : buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+    size_t Erase(const Key& key)
+    {
+        const uint64_t hash = ComputeHash(key);
+        Stripe& stripe = GetStripe(hash);
+        std::lock_guard guard(stripe.mutex);
+        if (stripe.size == 0) {
+            return 0;
+        }
+        size_t hole = FindPosition(stripe, key, hash);
+        if (!stripe.entries[hole]) {
+            return 0;
+        }
+        stripe.entries[hole].reset();
+        --stripe.size;
+
+        // Backward shift deletion keeps probe sequences unbroken without tombstones
+        const size_t mask = stripe.entries.size() - 1;
+        for (size_t next = (hole + 1) & mask; stripe.entries[next]; next = (next + 1) & mask) {
+            const size_t home = GetHomePosition(ComputeHash(stripe.entries[next]->first), mask);
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                stripe.entries[hole] = std::move(stripe.entries[next]);
+                stripe.entries[next].reset();
+                hole = next;
+            }
+        }
+        return 1;
+    }
+
+    size_t size() {
+        size_t result = 0;
+        for (Stripe& stripe : stripes_) {
+            std::lock_guard guard(stripe.mutex);
+            result += stripe.size;
         }
         return result;
     }
-    auto Erase(const Key& key)
-    {
-        size_t del_key = static_cast<uint64_t>(key) % buckets_.size();
-        std::lock_guard guard(buckets_[del_key].mutex);
-        return buckets_[del_key].map.erase(key);
+
+    // Calls function(const Key&, Value&) for every entry in place, stripes are visited under the policy
+    template <typename ExecutionPolicy, typename Function>
+    void ForEach(ExecutionPolicy&& policy, Function function) {
+        std::for_each(policy, stripes_.begin(), stripes_.end(), [&function](Stripe& stripe) {
+            std::lock_guard guard(stripe.mutex);
+            for (auto& entry : stripe.entries) {
+                if (entry) {
+                    function(static_cast<const Key&>(entry->first), entry->second);
+                }
+            }
+            });
+    }
+
+    template <typename Function>
+    void ForEach(Function function) {
+        ForEach(std::execution::seq, function);
+    }
+
+    // Copies the entries straight into a vector and sorts it by key
+    template <typename ExecutionPolicy, typename Compare = std::less<Key>>
+    std::vector<std::pair<Key, Value>> BuildSortedVector(ExecutionPolicy&& policy, Compare compare = Compare()) {
+        std::vector<std::pair<Key, Value>> result;
+        for (Stripe& stripe : stripes_) {
+            std::lock_guard guard(stripe.mutex);
+            for (const auto& entry : stripe.entries) {
+                if (entry) {
+                    result.push_back(*entry);
+                }
+            }
+        }
+        std::sort(policy, result.begin(), result.end(), [&compare](const auto& lhs, const auto& rhs) {
+            return compare(lhs.first, rhs.first);
+            });
+        return result;
+    }
+
+    std::vector<std::pair<Key, Value>> BuildSortedVector() {
+        return BuildSortedVector(std::execution::seq);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() {
+        std::map<Key, Value> result;
+        ForEach([&result](const Key& key, const Value& value) {
+            result.emplace(key, value);
+            });
+        return result;
     }
+
 private:
-    std::vector<Bucket> buckets_;
-};
\ No newline at end of file
+    static constexpr size_t MIN_STRIPE_CAPACITY = 8;
+
+    std::vector<Stripe> stripes_;
+    Hash hash_;
+    KeyEqual key_equal_;
+
+    uint64_t ComputeHash(const Key& key) const {
+        // Fibonacci hashing spreads weak hashes such as the identity hash of integers
+        return static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    Stripe& GetStripe(uint64_t hash) {
+        return stripes_[(hash >> 40) % stripes_.size()];
+    }
+
+    static size_t GetHomePosition(uint64_t hash, size_t mask) {
+        return static_cast<size_t>(hash ^ (hash >> 29)) & mask;
+    }
+
+    // Position of the key or of the empty entry where it would be inserted
+    size_t FindPosition(const Stripe& stripe, const Key& key, uint64_t hash) const {
+        const size_t mask = stripe.entries.size() - 1;
+        size_t position = GetHomePosition(hash, mask);
+        while (stripe.entries[position] && !key_equal_(stripe.entries[position]->first, key)) {
+            position = (position + 1) & mask;
+        }
+        return position;
+    }
+
+    Value& FindOrInsert(Stripe& stripe, const Key& key, uint64_t hash) const {
+        // Load factor is kept under 0.7
+        if ((stripe.size + 1) * 10 > stripe.entries.size() * 7) {
+            Grow(stripe);
+        }
+        const size_t position = FindPosition(stripe, key, hash);
+        if (!stripe.entries[position]) {
+            stripe.entries[position].emplace(key, Value());
+            ++stripe.size;
+        }
+        return stripe.entries[position]->second;
+    }
+
+    void Grow(Stripe& stripe) const {
+        std::vector<std::optional<std::pair<Key, Value>>> entries(std::max(MIN_STRIPE_CAPACITY, stripe.entries.size() * 2));
+        std::swap(entries, stripe.entries);
+        const size_t mask = stripe.entries.size() - 1;
+        for (auto& entry : entries) {
+            if (entry) {
+                size_t position = GetHomePosition(ComputeHash(entry->first), mask);
+                while (stripe.entries[position]) {
+                    position = (position + 1) & mask;
+                }
+                stripe.entries[position] = std::move(entry);
+            }
+        }
+    }
+};
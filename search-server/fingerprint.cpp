@@ -0,0 +1,13 @@
+#include "fingerprint.h"
+
+// The two halves are chained with different multipliers, so they collide independently
+void WordSetHasher::Add(uint32_t term_id) {
+    const uint64_t value = MixHash(term_id + 1);
+    low_ = ((low_ << 27 | low_ >> 37) ^ value) * 0x87C37B91114253D5ull;
+    high_ = ((high_ << 31 | high_ >> 33) ^ (value * 0x4CF5AD432745937Full)) * 0x52DCE729DA3ED6F5ull;
+    ++size_;
+}
+
+WordSetFingerprint WordSetHasher::Finish() const {
+    return { MixHash(low_ ^ size_), MixHash(high_ + size_) };
+}
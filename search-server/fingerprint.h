@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Finalizer of MurmurHash3, spreads every input bit over the whole result
+inline uint64_t MixHash(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+// 128-bit hash of a set of words. Equal sets always get equal fingerprints,
+// different ones almost never do, so exact checks are only needed on a match.
+struct WordSetFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+};
+
+inline bool operator==(const WordSetFingerprint& lhs, const WordSetFingerprint& rhs) {
+    return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+
+inline bool operator!=(const WordSetFingerprint& lhs, const WordSetFingerprint& rhs) {
+    return !(lhs == rhs);
+}
+
+struct WordSetFingerprintHash {
+    size_t operator()(const WordSetFingerprint& fingerprint) const {
+        return static_cast<size_t>(fingerprint.low);
+    }
+};
+
+// Hashes term ids given in ascending order, each id once
+class WordSetHasher {
+public:
+    void Add(uint32_t term_id);
+    WordSetFingerprint Finish() const;
+
+private:
+    uint64_t low_ = 0x9E3779B97F4A7C15ull;
+    uint64_t high_ = 0xC2B2AE3D27D4EB4Full;
+    uint64_t size_ = 0;
+};
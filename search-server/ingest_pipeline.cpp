@@ -0,0 +1,241 @@
+#include "ingest_pipeline.h"
+#include "bounded_queue.h"
+#include "read_input_functions.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+struct IngestChunk {
+    size_t sequence = 0;
+    size_t first_line = 0;
+    size_t last_line = 0;
+    std::vector<char> data;
+    // Texts of the documents point into data
+    std::vector<NewDocument> documents;
+    std::optional<SearchServer::PreparedDocuments> prepared;
+    // Error of reading or preparing the chunk, rethrown once the chunks before it are added
+    std::exception_ptr error;
+};
+
+using ChunkPointer = std::unique_ptr<IngestChunk>;
+
+// Limits the chunks read past the next one to add, so the chunks prepared out
+// of order wait in bounded memory however far ahead the tokenizers get
+class SequenceWindow {
+public:
+    explicit SequenceWindow(size_t size)
+        : size_(size > 0 ? size : 1) {
+    }
+
+    // Waits until the chunk fits in the window, returns false if the window was closed
+    bool Enter(size_t sequence) {
+        std::unique_lock lock(mutex_);
+        advanced_.wait(lock, [this, sequence] {
+            return closed_ || sequence < next_sequence_ + size_;
+        });
+        return !closed_;
+    }
+
+    // Called once the next chunk is added
+    void Advance() {
+        std::lock_guard lock(mutex_);
+        ++next_sequence_;
+        advanced_.notify_all();
+    }
+
+    void Close() {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+        advanced_.notify_all();
+    }
+
+private:
+    const size_t size_;
+    std::mutex mutex_;
+    std::condition_variable advanced_;
+    size_t next_sequence_ = 0;
+    bool closed_ = false;
+};
+
+// Numbers the chunks from sequence, which is left at the number of the chunk that was not queued
+void ReadChunks(std::istream& input, size_t chunk_size, SequenceWindow& window, BoundedQueue<ChunkPointer>& chunks,
+    size_t& sequence, size_t& byte_count)
+{
+    std::vector<char> carry;
+    size_t line = 1;
+    for (bool at_end = false; !at_end;) {
+        auto chunk = std::make_unique<IngestChunk>();
+        chunk->data = std::move(carry);
+        carry.clear();
+        const size_t carried_size = chunk->data.size();
+        chunk->data.resize(carried_size + chunk_size);
+        input.read(chunk->data.data() + carried_size, chunk_size);
+        const size_t read_size = static_cast<size_t>(input.gcount());
+        chunk->data.resize(carried_size + read_size);
+        byte_count += read_size;
+        if (input.bad()) {
+            throw std::runtime_error("Cannot read document dump"s);
+        }
+        at_end = read_size < chunk_size;
+        if (!at_end) {
+            // The incomplete last line goes to the next chunk, a line longer than a chunk makes it grow
+            const auto last_newline = std::find(chunk->data.rbegin(), chunk->data.rend(), '\n');
+            if (last_newline == chunk->data.rend()) {
+                carry = std::move(chunk->data);
+                continue;
+            }
+            carry.assign(last_newline.base(), chunk->data.end());
+            chunk->data.erase(last_newline.base(), chunk->data.end());
+        }
+        if (chunk->data.empty()) {
+            continue;
+        }
+        chunk->sequence = sequence;
+        chunk->first_line = line;
+        line += std::count(chunk->data.begin(), chunk->data.end(), '\n');
+        chunk->last_line = chunk->data.back() == '\n' ? line - 1 : line;
+        if (!window.Enter(sequence) || !chunks.Push(std::move(chunk))) {
+            return;
+        }
+        ++sequence;
+    }
+}
+
+void PrepareChunk(const SearchServer& server, IngestChunk& chunk) {
+    std::string_view rest(chunk.data.data(), chunk.data.size());
+    for (size_t line = chunk.first_line; !rest.empty(); ++line) {
+        const size_t line_end = std::min(rest.find('\n'), rest.size());
+        std::string_view text = rest.substr(0, line_end);
+        rest.remove_prefix(std::min(line_end + 1, rest.size()));
+        if (!text.empty() && text.back() == '\r') {
+            text.remove_suffix(1);
+        }
+        if (text.empty()) {
+            continue;
+        }
+        try {
+            chunk.documents.push_back(ParseDocumentLine(text));
+        }
+        catch (const std::invalid_argument& error) {
+            throw std::invalid_argument("Line "s + std::to_string(line) + ": "s + error.what());
+        }
+    }
+    chunk.prepared = server.PrepareDocuments(std::execution::seq, chunk.documents);
+}
+
+void AddChunk(SearchServer& server, IngestChunk& chunk) {
+    try {
+        server.AddDocuments(std::execution::par, std::move(*chunk.prepared));
+    }
+    catch (const std::invalid_argument& error) {
+        throw std::invalid_argument("Lines "s + std::to_string(chunk.first_line) + "-"s + std::to_string(chunk.last_line)
+            + ": "s + error.what());
+    }
+}
+}
+
+IngestStats IngestDocuments(SearchServer& server, std::istream& input, IngestOptions options) {
+    const size_t tokenizer_count = options.tokenizer_count > 0 ? options.tokenizer_count
+        : std::max<size_t>(1, std::thread::hardware_concurrency());
+    BoundedQueue<ChunkPointer> read_chunks(options.queue_capacity);
+    BoundedQueue<ChunkPointer> prepared_chunks(options.queue_capacity);
+    // Enough for every queue to be full and every tokenizer busy while the next chunk to add is still prepared
+    SequenceWindow window(2 * std::max<size_t>(options.queue_capacity, 1) + tokenizer_count);
+    IngestStats stats;
+
+    // Errors travel with the chunks, so the chunks before the first failing one are added
+    // and its error is the one rethrown, whatever order the stages fail in
+    std::thread reader([&] {
+        size_t sequence = 0;
+        try {
+            ReadChunks(input, std::max<size_t>(options.chunk_size, 1), window, read_chunks, sequence, stats.byte_count);
+        }
+        catch (...) {
+            auto chunk = std::make_unique<IngestChunk>();
+            chunk->sequence = sequence;
+            chunk->error = std::current_exception();
+            if (window.Enter(sequence)) {
+                read_chunks.Push(std::move(chunk));
+            }
+        }
+        read_chunks.Close();
+        });
+
+    std::atomic<size_t> running_tokenizers = tokenizer_count;
+    std::vector<std::thread> tokenizers;
+    for (size_t i = 0; i < tokenizer_count; ++i) {
+        tokenizers.emplace_back([&] {
+            while (auto chunk = read_chunks.Pop()) {
+                if (!(*chunk)->error) {
+                    try {
+                        PrepareChunk(server, **chunk);
+                    }
+                    catch (...) {
+                        (*chunk)->error = std::current_exception();
+                    }
+                }
+                if (!prepared_chunks.Push(std::move(*chunk))) {
+                    break;
+                }
+            }
+            if (--running_tokenizers == 0) {
+                prepared_chunks.Close();
+            }
+            });
+    }
+
+    // Chunks may be prepared out of order, they wait here until the previous ones are added
+    std::exception_ptr error;
+    try {
+        std::map<size_t, ChunkPointer> waiting_chunks;
+        size_t next_sequence = 0;
+        while (auto chunk = prepared_chunks.Pop()) {
+            waiting_chunks.emplace((*chunk)->sequence, std::move(*chunk));
+            for (auto iter = waiting_chunks.find(next_sequence); iter != waiting_chunks.end();
+                iter = waiting_chunks.find(++next_sequence)) {
+                if (iter->second->error) {
+                    std::rethrow_exception(iter->second->error);
+                }
+                AddChunk(server, *iter->second);
+                stats.document_count += iter->second->documents.size();
+                waiting_chunks.erase(iter);
+                window.Advance();
+            }
+        }
+    }
+    catch (...) {
+        error = std::current_exception();
+        window.Close();
+        read_chunks.Close();
+        prepared_chunks.Close();
+    }
+
+    reader.join();
+    for (std::thread& tokenizer : tokenizers) {
+        tokenizer.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return stats;
+}
+
+IngestStats IngestDocumentFile(SearchServer& server, const std::string& path, IngestOptions options) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Cannot open document dump "s + path);
+    }
+    return IngestDocuments(server, input, options);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <string>
+#include "search_server.h"
+
+struct IngestOptions {
+    // Bytes read at once, a chunk is then cut at the end of its last whole line
+    size_t chunk_size = 1 << 20;
+    // Threads parsing and tokenizing chunks, 0 means one per hardware thread
+    size_t tokenizer_count = 0;
+    // Chunks every queue between the stages may hold
+    size_t queue_capacity = 2;
+};
+
+struct IngestStats {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+};
+
+// Streams documents in the ParseDocumentLine format into the server. A reader
+// thread cuts the input into chunks of whole lines, tokenizer threads parse and
+// prepare the chunks, and the calling thread adds them in input order. Bounded
+// queues connect the stages and at most 2 * queue_capacity + tokenizer_count
+// chunks are read past the next one to add, so memory use does not grow with
+// the input size. The error of the first failing chunk in input order is
+// rethrown with its line numbers, documents of all chunks before it stay in the server.
+IngestStats IngestDocuments(SearchServer& server, std::istream& input, IngestOptions options = {});
+
+// Throws std::runtime_error if the file cannot be opened
+IngestStats IngestDocumentFile(SearchServer& server, const std::string& path, IngestOptions options = {});
@@ -0,0 +1,32 @@
+#include "lexicon.h"
+
+TermId Lexicon::Intern(const std::string_view term) {
+    if (const auto iter = term_to_id_.find(term); iter != term_to_id_.end()) {
+        return iter->second;
+    }
+    const std::string_view stored_term = arena_.Store(term);
+    const TermId term_id = static_cast<TermId>(id_to_term_.size());
+    id_to_term_.push_back(stored_term);
+    term_to_id_.emplace(stored_term, term_id);
+    return term_id;
+}
+
+TermId Lexicon::Find(const std::string_view term) const {
+    const auto iter = term_to_id_.find(term);
+    return iter == term_to_id_.end() ? NO_TERM : iter->second;
+}
+
+void Lexicon::Save(SnapshotWriter& writer) const {
+    writer.WriteStrings(id_to_term_);
+}
+
+void Lexicon::Load(SnapshotReader& reader) {
+    id_to_term_ = reader.ReadStrings();
+    term_to_id_.clear();
+    term_to_id_.reserve(id_to_term_.size());
+    for (TermId term_id = 0; term_id < id_to_term_.size(); ++term_id) {
+        if (!term_to_id_.emplace(id_to_term_[term_id], term_id).second) {
+            SnapshotReader::ThrowCorrupted();
+        }
+    }
+}
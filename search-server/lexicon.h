@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "term_arena.h"
+#include "snapshot.h"
+
+using TermId = uint32_t;
+
+// Stores every distinct term once in an arena and assigns it a dense id
+class Lexicon {
+public:
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    TermId Intern(const std::string_view term);
+
+    // Returns NO_TERM for terms that were never interned
+    TermId Find(const std::string_view term) const;
+
+    std::string_view GetTerm(TermId term_id) const {
+        return id_to_term_[term_id];
+    }
+
+    size_t size() const {
+        return id_to_term_.size();
+    }
+
+    void Save(SnapshotWriter& writer) const;
+
+    // Loaded terms view the snapshot data, terms interned later go to the arena
+    void Load(SnapshotReader& reader);
+
+private:
+    TermArena arena_;
+    std::vector<std::string_view> id_to_term_;
+    std::unordered_map<std::string_view, TermId> term_to_id_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Array that either owns its elements or views elements living elsewhere,
+// e.g. in a mapped snapshot file. Reads work the same in both modes, the
+// first mutable access copies viewed elements into owned storage.
+template <typename T>
+class MappableVector {
+public:
+    MappableVector() = default;
+
+    MappableVector(std::vector<T> elements)
+        : owned_(std::move(elements)) {
+    }
+
+    // The elements must outlive the returned vector and every copy of it
+    static MappableVector View(const T* data, size_t size) {
+        MappableVector result;
+        result.view_data_ = data;
+        result.view_size_ = size;
+        return result;
+    }
+
+    const T* data() const {
+        return view_data_ != nullptr ? view_data_ : owned_.data();
+    }
+
+    size_t size() const {
+        return view_data_ != nullptr ? view_size_ : owned_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    const T* begin() const {
+        return data();
+    }
+
+    const T* end() const {
+        return data() + size();
+    }
+
+    std::vector<T>& Mutable() {
+        if (view_data_ != nullptr) {
+            owned_.assign(view_data_, view_data_ + view_size_);
+            view_data_ = nullptr;
+            view_size_ = 0;
+        }
+        return owned_;
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* view_data_ = nullptr;
+    size_t view_size_ = 0;
+};
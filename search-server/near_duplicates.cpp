@@ -0,0 +1,182 @@
+#include "near_duplicates.h"
+#include <algorithm>
+#include <execution>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std::string_literals;
+
+NearDuplicateIndex::NearDuplicateIndex(const SearchServer& search_server, NearDuplicateOptions options)
+    : search_server_(search_server)
+    , options_(options)
+    , bands_(options.band_count) {
+    if (options.band_count == 0 || options.rows_per_band == 0) {
+        throw std::invalid_argument("Signatures must have at least one band and row"s);
+    }
+    AddDocuments(std::vector<int>(search_server.begin(), search_server.end()));
+}
+
+void NearDuplicateIndex::AddDocument(int document_id) {
+    InsertBands(document_id, ComputeBandHashes(document_id));
+}
+
+void NearDuplicateIndex::AddDocuments(const std::vector<int>& document_ids) {
+    std::vector<int> distinct_ids = document_ids;
+    std::sort(distinct_ids.begin(), distinct_ids.end());
+    distinct_ids.erase(std::unique(distinct_ids.begin(), distinct_ids.end()), distinct_ids.end());
+    std::vector<std::vector<uint64_t>> band_hashes(distinct_ids.size());
+    std::transform(std::execution::par, distinct_ids.begin(), distinct_ids.end(), band_hashes.begin(),
+        [this](int document_id) {
+            return ComputeBandHashes(document_id);
+        });
+    for (const int document_id : distinct_ids) {
+        RemoveDocument(document_id);
+    }
+    // Bands are independent tables, so they are filled in parallel
+    std::vector<size_t> band_indexes(bands_.size());
+    std::iota(band_indexes.begin(), band_indexes.end(), 0);
+    std::for_each(std::execution::par, band_indexes.begin(), band_indexes.end(), [&](size_t band) {
+        bands_[band].reserve(document_bands_.size() + distinct_ids.size());
+        for (size_t i = 0; i < distinct_ids.size(); ++i) {
+            bands_[band][band_hashes[i][band]].push_back(distinct_ids[i]);
+        }
+        });
+    document_bands_.reserve(document_bands_.size() + distinct_ids.size());
+    for (size_t i = 0; i < distinct_ids.size(); ++i) {
+        document_bands_.emplace(distinct_ids[i], std::move(band_hashes[i]));
+    }
+}
+
+void NearDuplicateIndex::RemoveDocument(int document_id) {
+    const auto iter = document_bands_.find(document_id);
+    if (iter == document_bands_.end()) {
+        return;
+    }
+    for (size_t band = 0; band < bands_.size(); ++band) {
+        const auto bucket = bands_[band].find(iter->second[band]);
+        auto& document_ids = bucket->second;
+        const auto position = std::find(document_ids.begin(), document_ids.end(), document_id);
+        document_ids.erase(position, position + 1);
+        if (document_ids.empty()) {
+            bands_[band].erase(bucket);
+        }
+    }
+    document_bands_.erase(iter);
+}
+
+std::vector<int> NearDuplicateIndex::FindNearDuplicates(int document_id) const {
+    const auto iter = document_bands_.find(document_id);
+    if (iter == document_bands_.end()) {
+        throw std::out_of_range("Not valid document id"s);
+    }
+    std::vector<int> near_duplicates = FindCandidates(document_id, iter->second);
+    near_duplicates.erase(std::remove_if(near_duplicates.begin(), near_duplicates.end(), [&](int other_id) {
+        return search_server_.GetWordSetSimilarity(document_id, other_id) < options_.min_similarity;
+        }), near_duplicates.end());
+    return near_duplicates;
+}
+
+std::vector<std::pair<int, int>> NearDuplicateIndex::FindNearDuplicatePairs() const {
+    std::vector<int> document_ids;
+    document_ids.reserve(document_bands_.size());
+    for (const auto& [document_id, band_hashes] : document_bands_) {
+        document_ids.push_back(document_id);
+    }
+    std::sort(document_ids.begin(), document_ids.end());
+
+    // Every document looks only for the larger ids, so each pair is confirmed once
+    std::vector<std::vector<int>> larger_near_duplicates(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), larger_near_duplicates.begin(),
+        [this](int document_id) {
+            std::vector<int> candidates = FindCandidates(document_id, document_bands_.at(document_id));
+            candidates.erase(candidates.begin(), std::upper_bound(candidates.begin(), candidates.end(), document_id));
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](int other_id) {
+                return search_server_.GetWordSetSimilarity(document_id, other_id) < options_.min_similarity;
+                }), candidates.end());
+            return candidates;
+        });
+
+    std::vector<std::pair<int, int>> pairs;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        for (const int other_id : larger_near_duplicates[i]) {
+            pairs.emplace_back(document_ids[i], other_id);
+        }
+    }
+    return pairs;
+}
+
+// One permutation hashing: the hash of a term picks a row and only the smallest value
+// of every row is kept, so a term is hashed once rather than once per row. An empty row
+// copies a filled one picked by its own hash sequence (optimal densification), and rows
+// of two sets stay equal with the probability of their Jaccard similarity.
+std::vector<uint64_t> NearDuplicateIndex::ComputeBandHashes(int document_id) const {
+    constexpr uint64_t EMPTY = std::numeric_limits<uint64_t>::max();
+    const size_t row_count = options_.band_count * options_.rows_per_band;
+    const auto pick_row = [row_count](uint64_t hash) {
+        return static_cast<size_t>(((hash >> 32) * row_count) >> 32);
+    };
+    std::vector<uint64_t> values(row_count, EMPTY);
+    for (const TermId term_id : search_server_.GetDocumentTerms(document_id)) {
+        const uint64_t term_hash = MixHash(term_id + 1);
+        uint64_t& value = values[pick_row(term_hash)];
+        value = std::min<uint64_t>(value, static_cast<uint32_t>(term_hash));
+    }
+    std::vector<uint64_t> signature = values;
+    const bool has_terms = std::any_of(values.begin(), values.end(), [](uint64_t value) { return value != EMPTY; });
+    for (size_t row = 0; has_terms && row < row_count; ++row) {
+        for (uint64_t attempt = 1; signature[row] == EMPTY; ++attempt) {
+            signature[row] = values[pick_row(MixHash(row * 0x9E3779B97F4A7C15ull + attempt))];
+        }
+    }
+
+    std::vector<uint64_t> band_hashes(options_.band_count);
+    for (size_t band = 0; band < options_.band_count; ++band) {
+        uint64_t band_hash = band;
+        for (size_t row = band * options_.rows_per_band; row < (band + 1) * options_.rows_per_band; ++row) {
+            band_hash = MixHash(band_hash * 0x9E3779B97F4A7C15ull + signature[row]);
+        }
+        band_hashes[band] = band_hash;
+    }
+    return band_hashes;
+}
+
+void NearDuplicateIndex::InsertBands(int document_id, std::vector<uint64_t> band_hashes) {
+    RemoveDocument(document_id);
+    for (size_t band = 0; band < bands_.size(); ++band) {
+        bands_[band][band_hashes[band]].push_back(document_id);
+    }
+    document_bands_.emplace(document_id, std::move(band_hashes));
+}
+
+std::vector<int> NearDuplicateIndex::FindCandidates(int document_id, const std::vector<uint64_t>& band_hashes) const {
+    std::vector<int> candidates;
+    for (size_t band = 0; band < bands_.size(); ++band) {
+        const auto& document_ids = bands_[band].at(band_hashes[band]);
+        std::copy_if(document_ids.begin(), document_ids.end(), std::back_inserter(candidates), [document_id](int other_id) {
+            return other_id != document_id;
+            });
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, NearDuplicateOptions options) {
+    // Pairs come in ascending order, so whether the first document is kept is already known
+    std::unordered_set<int> docs_to_del;
+    std::vector<int> removal_order;
+    for (const auto& [document_id, other_id] : NearDuplicateIndex(search_server, options).FindNearDuplicatePairs()) {
+        if (docs_to_del.count(document_id) == 0 && docs_to_del.insert(other_id).second) {
+            removal_order.push_back(other_id);
+        }
+    }
+    std::sort(removal_order.begin(), removal_order.end());
+    for (const auto id : removal_order) {
+        search_server.RemoveDocument(id);
+        std::cout << "Found near-duplicate document id " << id << std::endl;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "search_server.h"
+#include "small_vector.h"
+
+struct NearDuplicateOptions {
+    // Least Jaccard similarity of the word sets of near-duplicates
+    double min_similarity = 0.8;
+    // Signatures have band_count * rows_per_band MinHash values. Documents with similarity s
+    // share a band with probability 1 - (1 - s^rows_per_band)^band_count.
+    size_t band_count = 20;
+    size_t rows_per_band = 5;
+};
+
+// LSH index of the MinHash signatures of the documents of one server. Only documents
+// that share a band of their signatures are compared, and these candidates are
+// confirmed by the exact similarity of their word sets.
+class NearDuplicateIndex {
+public:
+    // Indexes every document of the server
+    explicit NearDuplicateIndex(const SearchServer& search_server, NearDuplicateOptions options = {});
+
+    // Documents are indexed once they are in the server, signatures of a batch are computed in parallel
+    void AddDocument(int document_id);
+    void AddDocuments(const std::vector<int>& document_ids);
+    // Does not read the server, so the document may already be removed from it
+    void RemoveDocument(int document_id);
+
+    // Other indexed documents similar to this one, in ascending order of ids
+    std::vector<int> FindNearDuplicates(int document_id) const;
+    // Every pair of near-duplicates once, the smaller id first, in ascending order
+    std::vector<std::pair<int, int>> FindNearDuplicatePairs() const;
+
+private:
+    const SearchServer& search_server_;
+    NearDuplicateOptions options_;
+    // Documents by the hash of one band of their signatures, a map per band.
+    // Most buckets hold a single document and need no allocation.
+    std::vector<std::unordered_map<uint64_t, SmallVector<int, 2>>> bands_;
+    std::unordered_map<int, std::vector<uint64_t>> document_bands_;
+
+    std::vector<uint64_t> ComputeBandHashes(int document_id) const;
+    void InsertBands(int document_id, std::vector<uint64_t> band_hashes);
+    std::vector<int> FindCandidates(int document_id, const std::vector<uint64_t>& band_hashes) const;
+};
+
+// Removes the documents similar to a kept document with a smaller id
+void RemoveNearDuplicates(SearchServer& search_server, NearDuplicateOptions options = {});
@@ -68,5 +68,5 @@ private:
 
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
-    return Paginator(begin(c), end(c), page_size);
+    return Paginator(std::begin(c), std::end(c), page_size);
 }
\ No newline at end of file
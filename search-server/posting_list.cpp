@@ -0,0 +1,273 @@
+#include "posting_list.h"
+#include <algorithm>
+
+namespace {
+// SIMD-BP128 vertical layout: value i goes to lane i % 4 and every lane is a
+// separate bit stream, so the four lanes are unpacked with identical operations
+constexpr size_t LANES = 4;
+constexpr size_t VALUES_PER_LANE = PostingList::BLOCK_SIZE / LANES;
+
+uint32_t BitWidth(uint32_t value) {
+    uint32_t bits = 0;
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// Writes BLOCK_SIZE values of the given width into 4 * bits words
+void PackVertical(const uint32_t* values, uint32_t bits, uint32_t* out) {
+    if (bits == 0) {
+        return;
+    }
+    for (size_t lane = 0; lane < LANES; ++lane) {
+        uint64_t buffer = 0;
+        uint32_t filled = 0;
+        size_t word = 0;
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+            buffer |= static_cast<uint64_t>(values[i * LANES + lane]) << filled;
+            filled += bits;
+            if (filled >= 32) {
+                out[word++ * LANES + lane] = static_cast<uint32_t>(buffer);
+                buffer >>= 32;
+                filled -= 32;
+            }
+        }
+    }
+}
+
+void UnpackVertical(const uint32_t* in, uint32_t bits, uint32_t* values) {
+    if (bits == 0) {
+        std::fill(values, values + PostingList::BLOCK_SIZE, 0u);
+        return;
+    }
+    const uint64_t mask = (uint64_t{ 1 } << bits) - 1;
+    uint64_t buffer[LANES] = {};
+    uint32_t filled = 0;
+    for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+        if (filled < bits) {
+            for (size_t lane = 0; lane < LANES; ++lane) {
+                buffer[lane] |= static_cast<uint64_t>(in[lane]) << filled;
+            }
+            in += LANES;
+            filled += 32;
+        }
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            values[i * LANES + lane] = static_cast<uint32_t>(buffer[lane] & mask);
+            buffer[lane] >>= bits;
+        }
+        filled -= bits;
+    }
+}
+
+void PutVarint(std::vector<uint8_t>& bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+// Checks that the bytes hold exactly count varints of at most 5 bytes, the length of the largest uint32_t
+bool IsVarintStream(const uint8_t* bytes, size_t size, size_t count) {
+    size_t ends = 0;
+    size_t continuations = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (bytes[i] < 0x80) {
+            ++ends;
+            continuations = 0;
+        }
+        else if (++continuations > 4) {
+            return false;
+        }
+    }
+    return ends == count && (size == 0 || bytes[size - 1] < 0x80);
+}
+
+uint32_t GetVarint(const uint8_t*& bytes) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0;; shift += 7) {
+        const uint8_t byte = *bytes++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+}
+
+void PostingList::Add(uint32_t slot, uint32_t count, double term_freq) {
+    if (tail_.size == 0) {
+        tail_.first_slot = slot;
+        PutVarint(tail_bytes_.Mutable(), 0);
+    }
+    else {
+        PutVarint(tail_bytes_.Mutable(), slot - tail_.last_slot);
+    }
+    PutVarint(tail_bytes_.Mutable(), count - 1);
+    tail_.last_slot = slot;
+    ++tail_.size;
+    tail_.max_term_freq = std::max(tail_.max_term_freq, term_freq);
+    ++size_;
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+
+    if (tail_.size == BLOCK_SIZE) {
+        std::array<uint32_t, BLOCK_SIZE> slots;
+        std::array<uint32_t, BLOCK_SIZE> counts;
+        DecodeBlock(blocks_.size(), slots.data(), counts.data());
+        AppendBlock(slots.data(), counts.data(), tail_.max_term_freq);
+        tail_ = Block{};
+        tail_bytes_.Mutable().clear();
+    }
+}
+
+size_t PostingList::GetEncodedSize() const {
+    return packed_.size() * sizeof(uint32_t) + blocks_.size() * sizeof(Block) + tail_bytes_.size();
+}
+
+size_t PostingList::FindBlock(size_t first_block, int64_t slot) const {
+    const auto iter = std::lower_bound(blocks_.begin() + std::min(first_block, blocks_.size()), blocks_.end(), slot,
+        [](const Block& block, int64_t slot) {
+            return block.last_slot < slot;
+        });
+    if (iter != blocks_.end()) {
+        return iter - blocks_.begin();
+    }
+    if (tail_.size > 0 && tail_.last_slot >= slot) {
+        return blocks_.size();
+    }
+    return GetBlockCount();
+}
+
+size_t PostingList::DecodeBlock(size_t block, uint32_t* slots, uint32_t* counts) const {
+    if (block == blocks_.size()) {
+        const uint8_t* bytes = tail_bytes_.data();
+        uint32_t slot = tail_.first_slot;
+        for (size_t i = 0; i < tail_.size; ++i) {
+            slot += GetVarint(bytes);
+            slots[i] = slot;
+            counts[i] = GetVarint(bytes) + 1;
+        }
+        return tail_.size;
+    }
+    const Block& header = blocks_[block];
+    const uint32_t* data = packed_.data() + header.offset;
+    UnpackVertical(data, header.slot_bits, slots);
+    UnpackVertical(data + LANES * header.slot_bits, header.count_bits, counts);
+    slots[0] += header.first_slot;
+    for (size_t i = 1; i < header.size; ++i) {
+        slots[i] += slots[i - 1];
+    }
+    for (size_t i = 0; i < header.size; ++i) {
+        ++counts[i];
+    }
+    return header.size;
+}
+
+void PostingList::AppendBlock(const uint32_t* slots, const uint32_t* counts, double max_term_freq) {
+    std::array<uint32_t, BLOCK_SIZE> deltas;
+    std::array<uint32_t, BLOCK_SIZE> counts_minus_one;
+    uint32_t max_delta = 0;
+    uint32_t max_count = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        deltas[i] = i == 0 ? 0 : slots[i] - slots[i - 1];
+        counts_minus_one[i] = counts[i] - 1;
+        max_delta = std::max(max_delta, deltas[i]);
+        max_count = std::max(max_count, counts_minus_one[i]);
+    }
+    const uint32_t slot_bits = BitWidth(max_delta);
+    const uint32_t count_bits = BitWidth(max_count);
+
+    Block& header = blocks_.Mutable().emplace_back();
+    header.first_slot = slots[0];
+    header.last_slot = slots[BLOCK_SIZE - 1];
+    header.offset = static_cast<uint32_t>(packed_.size());
+    header.size = static_cast<uint16_t>(BLOCK_SIZE);
+    header.slot_bits = static_cast<uint8_t>(slot_bits);
+    header.count_bits = static_cast<uint8_t>(count_bits);
+    header.max_term_freq = max_term_freq;
+    std::vector<uint32_t>& packed = packed_.Mutable();
+    packed.resize(packed.size() + LANES * (slot_bits + count_bits));
+    PackVertical(deltas.data(), slot_bits, packed.data() + header.offset);
+    PackVertical(counts_minus_one.data(), count_bits, packed.data() + header.offset + LANES * slot_bits);
+}
+
+void PostingList::Save(SnapshotWriter& writer) const {
+    writer.WriteValue<uint64_t>(size_);
+    writer.WriteValue(max_term_freq_);
+    writer.WriteValue(tail_);
+    writer.WriteArray(tail_bytes_);
+    writer.WriteArray(blocks_);
+    writer.WriteArray(packed_);
+}
+
+PostingList PostingList::Load(SnapshotReader& reader) {
+    PostingList postings;
+    postings.size_ = static_cast<size_t>(reader.ReadValue<uint64_t>());
+    postings.max_term_freq_ = reader.ReadValue<double>();
+    postings.tail_ = reader.ReadValue<Block>();
+    postings.tail_bytes_ = reader.ReadArray<uint8_t>();
+    postings.blocks_ = reader.ReadArray<Block>();
+    postings.packed_ = reader.ReadArray<uint32_t>();
+    // Offsets are checked once here, so queries over a damaged file cannot read out of bounds
+    size_t block_postings = 0;
+    for (const Block& block : postings.blocks_) {
+        if (block.size == 0 || block.size > BLOCK_SIZE || block.slot_bits > 32 || block.count_bits > 32
+            || block.offset + LANES * (block.slot_bits + block.count_bits) > postings.packed_.size()) {
+            SnapshotReader::ThrowCorrupted();
+        }
+        block_postings += block.size;
+    }
+    if (postings.tail_.size >= BLOCK_SIZE || block_postings + postings.tail_.size != postings.size_
+        || !IsVarintStream(postings.tail_bytes_.data(), postings.tail_bytes_.size(), 2 * postings.tail_.size)) {
+        SnapshotReader::ThrowCorrupted();
+    }
+    return postings;
+}
+
+bool PostingList::HasSlotsBelow(uint32_t slot_count, bool check_postings) const {
+    for (size_t block = 0; block < GetBlockCount(); ++block) {
+        const Block& header = GetBlock(block);
+        if (header.first_slot > header.last_slot || header.last_slot >= slot_count) {
+            return false;
+        }
+    }
+    bool slots_below = true;
+    if (check_postings) {
+        ForEach([&](uint32_t slot, uint32_t) {
+            slots_below = slots_below && slot < slot_count;
+            });
+    }
+    return slots_below;
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+    : postings_(&postings) {
+    LoadBlock(0);
+}
+
+void PostingList::Cursor::SkipTo(int64_t slot) {
+    if (GetSlot() >= slot) {
+        return;
+    }
+    if (slots_[block_size_ - 1] < slot) {
+        LoadBlock(postings_->FindBlock(block_ + 1, slot));
+    }
+    position_ = std::lower_bound(slots_.begin() + position_, slots_.begin() + block_size_, slot) - slots_.begin();
+}
+
+PostingList::Cursor::BlockBound PostingList::Cursor::GetBlockBound(int64_t slot) const {
+    const size_t block = postings_->FindBlock(block_, slot);
+    if (block == postings_->GetBlockCount()) {
+        return { 0.0, END };
+    }
+    const Block& header = postings_->GetBlock(block);
+    return { header.max_term_freq, header.last_slot };
+}
+
+void PostingList::Cursor::LoadBlock(size_t block) {
+    block_ = block;
+    position_ = 0;
+    block_size_ = block < postings_->GetBlockCount() ? postings_->DecodeBlock(block, slots_.data(), counts_.data()) : 0;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "mappable_vector.h"
+#include "snapshot.h"
+
+// Postings of a single word sorted by document slot. Each posting keeps the
+// number of occurrences of the word; the term frequency is that count divided
+// by the document length, which the server stores per slot.
+//
+// Full blocks of BLOCK_SIZE postings are delta-encoded and bit-packed, the
+// partially filled last block is a varint stream that appends go to. Block
+// headers hold the slot range and the maximal term frequency, so lookups skip
+// blocks without decoding them.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // slot must be greater than every slot already in the list
+    void Add(uint32_t slot, uint32_t count, double term_freq);
+
+    // Calls function(slot, count) for the postings with slots in [first_slot, last_slot)
+    template <typename Function>
+    void ForEachInRange(uint32_t first_slot, uint32_t last_slot, Function function) const;
+
+    template <typename Function>
+    void ForEach(Function function) const {
+        ForEachInRange(0, std::numeric_limits<uint32_t>::max(), function);
+    }
+
+    double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Bytes taken by encoded postings and block headers
+    size_t GetEncodedSize() const;
+
+    void Save(SnapshotWriter& writer) const;
+
+    // The loaded list views the snapshot data until it is first modified
+    static PostingList Load(SnapshotReader& reader);
+
+    // Whether every slot of a loaded list is below slot_count. Block headers are always
+    // checked, the postings themselves are decoded only with check_postings.
+    bool HasSlotsBelow(uint32_t slot_count, bool check_postings) const;
+
+    // Forward-only traversal for document-at-a-time query processing
+    class Cursor {
+    public:
+        static constexpr int64_t END = std::numeric_limits<int64_t>::max();
+
+        struct BlockBound {
+            double max_term_freq;
+            int64_t last_slot;
+        };
+
+        explicit Cursor(const PostingList& postings);
+
+        // Returns END once the list is exhausted
+        int64_t GetSlot() const {
+            return position_ < block_size_ ? slots_[position_] : END;
+        }
+
+        uint32_t GetCount() const {
+            return counts_[position_];
+        }
+
+        // Moves to the first posting with a slot not less than the given one
+        void SkipTo(int64_t slot);
+
+        // Bounds the postings from slot up to the end of the block containing it
+        BlockBound GetBlockBound(int64_t slot) const;
+
+    private:
+        const PostingList* postings_;
+        size_t block_ = 0;
+        size_t position_ = 0;
+        size_t block_size_ = 0;
+        std::array<uint32_t, BLOCK_SIZE> slots_;
+        std::array<uint32_t, BLOCK_SIZE> counts_;
+
+        void LoadBlock(size_t block);
+    };
+
+private:
+    struct Block {
+        uint32_t first_slot = 0;
+        uint32_t last_slot = 0;
+        uint32_t offset = 0;
+        uint16_t size = 0;
+        uint8_t slot_bits = 0;
+        uint8_t count_bits = 0;
+        double max_term_freq = 0.0;
+    };
+
+    MappableVector<Block> blocks_;
+    // Bit-packed data of blocks_
+    MappableVector<uint32_t> packed_;
+    // The last, partially filled block: varint pairs of slot delta and count - 1
+    Block tail_;
+    MappableVector<uint8_t> tail_bytes_;
+    size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+
+    size_t GetBlockCount() const {
+        return blocks_.size() + (tail_.size > 0 ? 1 : 0);
+    }
+
+    const Block& GetBlock(size_t block) const {
+        return block < blocks_.size() ? blocks_[block] : tail_;
+    }
+
+    // First block starting from the given one whose last slot is not less than slot
+    size_t FindBlock(size_t first_block, int64_t slot) const;
+
+    // Decodes a block into the arrays and returns the number of postings in it
+    size_t DecodeBlock(size_t block, uint32_t* slots, uint32_t* counts) const;
+
+    // Packs a full block of postings after the last one
+    void AppendBlock(const uint32_t* slots, const uint32_t* counts, double max_term_freq);
+};
+
+template <typename Function>
+void PostingList::ForEachInRange(uint32_t first_slot, uint32_t last_slot, Function function) const {
+    std::array<uint32_t, BLOCK_SIZE> slots;
+    std::array<uint32_t, BLOCK_SIZE> counts;
+    for (size_t block = FindBlock(0, first_slot); block < GetBlockCount() && GetBlock(block).first_slot < last_slot; ++block) {
+        const size_t block_size = DecodeBlock(block, slots.data(), counts.data());
+        for (size_t i = 0; i < block_size; ++i) {
+            if (slots[i] >= first_slot && slots[i] < last_slot) {
+                function(slots[i], counts[i]);
+            }
+        }
+    }
+}
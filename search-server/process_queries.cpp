@@ -1,42 +1,71 @@
 #include "process_queries.h"
 #include <vector>
 #include <string>
+#include <exception>
 #include <execution>
-#include <list>
-#include <iterator>
+
+namespace {
+std::vector<Document> JoinDocuments(const std::vector<std::vector<Document>>& documents_lists) {
+    size_t document_count = 0;
+    for (const auto& documents_list : documents_lists) {
+        document_count += documents_list.size();
+    }
+    std::vector<Document> documents;
+    documents.reserve(document_count);
+    for (const auto& documents_list : documents_lists) {
+        documents.insert(documents.end(), documents_list.begin(), documents_list.end());
+    }
+    return documents;
+}
+}
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries)
 {
-    std::vector<std::vector<Document>> documents_lists(queries.size());
-    std::transform(
-        std::execution::par,
-        queries.cbegin(),
-        queries.cend(),
-        documents_lists.begin(),
-        [&search_server](const std::string& s)
-        { return search_server.FindTopDocuments(s); });
-    return documents_lists;
+    return search_server.FindTopDocumentsBatch(queries);
 }
 
-std::list<Document> ProcessQueriesJoined(
+std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries)
 {
-    std::vector<std::vector<Document>> documents_lists(queries.size());
+    return JoinDocuments(ProcessQueries(search_server, queries));
+}
 
-    std::transform(std::execution::par,
+std::vector<std::vector<Document>> ProcessQueries(
+    QueryCache& query_cache,
+    const std::vector<std::string>& queries)
+{
+    // An exception must not leave a parallel algorithm, the first invalid query in the batch is reported
+    std::vector<std::vector<Document>> documents_lists(queries.size());
+    std::vector<std::exception_ptr> errors(queries.size());
+    std::transform(
+        std::execution::par,
         queries.cbegin(),
         queries.cend(),
         documents_lists.begin(),
-        [&search_server](const std::string& s) {
-            return search_server.FindTopDocuments(s);
+        [&](const std::string& s)
+        {
+            try {
+                return query_cache.FindTopDocuments(s);
+            }
+            catch (...) {
+                errors[&s - queries.data()] = std::current_exception();
+                return std::vector<Document>();
+            }
         });
-
-    std::list<Document> documents;
-    for (const auto& documents_list : documents_lists) {
-        documents.splice(documents.end(), std::list(documents_list.begin(), documents_list.end()));
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
     }
-    return documents;
-}
\ No newline at end of file
+    return documents_lists;
+}
+
+std::vector<Document> ProcessQueriesJoined(
+    QueryCache& query_cache,
+    const std::vector<std::string>& queries)
+{
+    return JoinDocuments(ProcessQueries(query_cache, queries));
+}
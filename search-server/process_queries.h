@@ -2,13 +2,24 @@
 
 #include <vector>
 #include <string>
-#include <list>
 #include "search_server.h"
+#include "query_cache.h"
 
+// Repeated queries are searched once, see SearchServer::FindTopDocumentsBatch
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(
+// Results of all queries one after another in a single array
+std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+// Repeated queries are answered from the cache
+std::vector<std::vector<Document>> ProcessQueries(
+    QueryCache& query_cache,
+    const std::vector<std::string>& queries);
+
+std::vector<Document> ProcessQueriesJoined(
+    QueryCache& query_cache,
+    const std::vector<std::string>& queries);
@@ -0,0 +1,78 @@
+#include "query_cache.h"
+#include <algorithm>
+#include <functional>
+
+QueryCache::QueryCache(const SearchServer& search_server, QueryCacheOptions options)
+    : search_server_(search_server)
+    , shards_(std::max<size_t>(1, std::min(options.shard_count, options.capacity))) {
+    shard_capacity_ = options.capacity / shards_.size();
+}
+
+std::vector<Document> QueryCache::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+    size_t max_result_count)
+{
+    const auto query = search_server_.PrepareQuery(raw_query);
+    return FindCached(MakeKey(query, 'S', static_cast<uint64_t>(status), max_result_count), [&]() {
+        return search_server_.FindTopDocuments(query, status, max_result_count);
+        });
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+    return { hits_.load(), misses_.load() };
+}
+
+std::string QueryCache::MakeKey(const SearchServer::ParsedQuery& query, char filter_kind, uint64_t filter_id,
+    size_t max_result_count) const
+{
+    std::string key = search_server_.GetQueryKey(query);
+    const uint64_t result_count = max_result_count;
+    key.push_back(filter_kind);
+    key.append(reinterpret_cast<const char*>(&filter_id), sizeof(filter_id));
+    key.append(reinterpret_cast<const char*>(&result_count), sizeof(result_count));
+    return key;
+}
+
+QueryCache::Shard& QueryCache::GetShard(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const std::string& key, uint64_t epoch) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto iter = shard.index.find(key);
+    if (iter == shard.index.end()) {
+        return std::nullopt;
+    }
+    const auto entry = iter->second;
+    if (entry->epoch != epoch) {
+        shard.index.erase(iter);
+        shard.entries.erase(entry);
+        return std::nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    return entry->documents;
+}
+
+void QueryCache::Insert(std::string key, uint64_t epoch, const std::vector<Document>& documents) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    // Another thread may have searched for the same query meanwhile
+    const auto iter = shard.index.find(key);
+    if (iter != shard.index.end()) {
+        if (iter->second->epoch <= epoch) {
+            iter->second->epoch = epoch;
+            iter->second->documents = documents;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+        return;
+    }
+    if (shard_capacity_ == 0) {
+        return;
+    }
+    if (shard.entries.size() == shard_capacity_) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({ std::move(key), epoch, documents });
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+}
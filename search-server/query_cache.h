@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+
+struct QueryCacheOptions {
+    // Result lists kept over all shards, nothing is cached if it is 0
+    size_t capacity = 4096;
+    // Lowered to the capacity, so that every shard keeps at least one list
+    size_t shard_count = 16;
+};
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// LRU cache of the search results of one server. Results are keyed by the parsed
+// query, so the order of words and repeated words do not matter, and are dropped once
+// the server epoch changes. Concurrent lookups lock only the shard of their key.
+class QueryCache {
+public:
+    explicit QueryCache(const SearchServer& search_server, QueryCacheOptions options = {});
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT);
+
+    // Predicates are told apart by predicate_id only, equal ids must select equal documents
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, uint64_t predicate_id,
+        DocumentPredicate document_predicate, size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT);
+
+    QueryCacheStats GetStats() const;
+
+    const SearchServer& GetSearchServer() const {
+        return search_server_;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t epoch;
+        std::vector<Document> documents;
+    };
+
+    // The most recently used entries come first, the index views their keys
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    };
+
+    const SearchServer& search_server_;
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_{ 0 };
+    std::atomic<uint64_t> misses_{ 0 };
+
+    std::string MakeKey(const SearchServer::ParsedQuery& query, char filter_kind, uint64_t filter_id, size_t max_result_count) const;
+    Shard& GetShard(const std::string& key);
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t epoch);
+    void Insert(std::string key, uint64_t epoch, const std::vector<Document>& documents);
+
+    template <typename Search>
+    std::vector<Document> FindCached(std::string key, Search search);
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> QueryCache::FindTopDocuments(std::string_view raw_query, uint64_t predicate_id,
+    DocumentPredicate document_predicate, size_t max_result_count)
+{
+    const auto query = search_server_.PrepareQuery(raw_query);
+    return FindCached(MakeKey(query, 'P', predicate_id, max_result_count), [&]() {
+        return search_server_.FindTopDocuments(query, document_predicate, max_result_count);
+        });
+}
+
+template <typename Search>
+std::vector<Document> QueryCache::FindCached(std::string key, Search search) {
+    const uint64_t epoch = search_server_.GetEpoch();
+    if (auto documents = Find(key, epoch)) {
+        ++hits_;
+        return std::move(*documents);
+    }
+    ++misses_;
+    std::vector<Document> documents = search();
+    Insert(std::move(key), epoch, documents);
+    return documents;
+}
@@ -1,6 +1,10 @@
 #include "read_input_functions.h"
 #include <iostream>
 #include <string>
+#include <charconv>
+#include <stdexcept>
+
+using namespace std::string_literals;
 
 std::string ReadLine() {
     std::string s;
@@ -13,4 +17,46 @@ int ReadLineWithNumber() {
     std::cin >> result;
     ReadLine();
     return result;
-}
\ No newline at end of file
+}
+
+namespace {
+std::string_view TakeField(std::string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw std::invalid_argument("Document line must have four tab-separated fields"s);
+    }
+    const std::string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+int ParseInt(std::string_view text) {
+    int value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid number "s + std::string(text));
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(std::string_view text) {
+    static const std::string_view names[] = { "ACTUAL", "IRRELEVANT", "BANNED", "REMOVED" };
+    for (size_t status = 0; status < std::size(names); ++status) {
+        if (text == names[status] || (text.size() == 1 && text[0] == '0' + static_cast<char>(status))) {
+            return static_cast<DocumentStatus>(status);
+        }
+    }
+    throw std::invalid_argument("Invalid document status "s + std::string(text));
+}
+}
+
+NewDocument ParseDocumentLine(std::string_view line) {
+    NewDocument document;
+    document.id = ParseInt(TakeField(line));
+    document.status = ParseStatus(TakeField(line));
+    for (const std::string_view rating : SplitIntoWords(TakeField(line))) {
+        document.ratings.push_back(ParseInt(rating));
+    }
+    document.text = line;
+    return document;
+}
@@ -1,5 +1,12 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include "search_server.h"
 
 std::string ReadLine();
-int ReadLineWithNumber();
\ No newline at end of file
+int ReadLineWithNumber();
+
+// Parses a document dump line: id, status, ratings separated by spaces and
+// text, the four fields separated by tabs. The text of the returned document
+// points into the line. Throws std::invalid_argument if the line is malformed.
+NewDocument ParseDocumentLine(std::string_view line);
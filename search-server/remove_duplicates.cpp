@@ -1,19 +1,31 @@
 #include "remove_duplicates.h"
-#include <set>
-#include <iterator>
+#include <algorithm>
+#include <execution>
+#include <unordered_map>
+#include <vector>
 
 void RemoveDuplicates(SearchServer& search_server)
 {
-    std::set<std::set<std::string_view>> dupl_set;
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<WordSetFingerprint> fingerprints(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+        [&search_server](int document_id) {
+            return search_server.GetWordSetFingerprint(document_id);
+        });
+
+    // Documents are kept in id order, equal fingerprints are confirmed by comparing the words
+    std::unordered_map<WordSetFingerprint, std::vector<int>, WordSetFingerprintHash> kept_documents;
     std::vector<int> docs_to_del;
-    for (const int document_id : search_server) {
-        auto word_freq = search_server.GetWordFrequencies(document_id);
-        std::set<std::string_view> doc_words;
-        std::transform(word_freq.begin(), word_freq.end(),
-            std::inserter(doc_words, doc_words.end()),
-            [](const auto& pair) { return pair.first; });
-        if (!dupl_set.insert(doc_words).second) {
-            docs_to_del.push_back(document_id);
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        auto& same_fingerprint = kept_documents[fingerprints[i]];
+        if (std::any_of(same_fingerprint.begin(), same_fingerprint.end(), [&](int kept_id) {
+            return search_server.HaveSameWords(kept_id, document_ids[i]);
+            }))
+        {
+            docs_to_del.push_back(document_ids[i]);
+        }
+        else {
+            same_fingerprint.push_back(document_ids[i]);
         }
     }
     for (const auto id : docs_to_del) {
@@ -6,13 +6,22 @@ RequestQueue::RequestQueue(const SearchServer& search_server)
     , current_time_(0) {
 }
 
+RequestQueue::RequestQueue(QueryCache& query_cache)
+    : RequestQueue(query_cache.GetSearchServer()) {
+    query_cache_ = &query_cache;
+}
+
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    const auto result = search_server_.FindTopDocuments(raw_query, status);
+    const auto result = query_cache_
+        ? query_cache_->FindTopDocuments(raw_query, status)
+        : search_server_.FindTopDocuments(raw_query, status);
     AddRequest(result.size());
     return result;
 }
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    const auto result = search_server_.FindTopDocuments(raw_query);
+    const auto result = query_cache_
+        ? query_cache_->FindTopDocuments(raw_query)
+        : search_server_.FindTopDocuments(raw_query);
     AddRequest(result.size());
     return result;
 }
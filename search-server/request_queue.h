@@ -3,10 +3,13 @@
 #include <vector>
 #include <deque>
 #include "search_server.h"
+#include "query_cache.h"
 
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer& search_server);
+    // Requests by status are answered through the cache, the ones with predicates go to its server
+    explicit RequestQueue(QueryCache& query_cache);
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
@@ -21,6 +24,7 @@ private:
     };
     std::deque<QueryResult> requests_;
     const SearchServer& search_server_;
+    QueryCache* query_cache_ = nullptr;
     int no_results_requests_;
     uint64_t current_time_;
     const static int min_in_day_ = 1440;
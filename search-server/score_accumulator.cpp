@@ -0,0 +1,37 @@
+#include "score_accumulator.h"
+#include <memory>
+
+namespace {
+// Nested searches on one thread (e.g. from a predicate) take the next accumulator
+struct AccumulatorPool {
+    std::vector<std::unique_ptr<ScoreAccumulator>> accumulators;
+    size_t in_use = 0;
+};
+
+thread_local AccumulatorPool accumulator_pool;
+}
+
+void ScoreAccumulator::Reset(uint32_t first_slot, size_t slot_count) {
+    for (const uint32_t slot : touched_) {
+        const size_t index = slot - first_slot_;
+        scores_[index] = 0.0;
+        states_[index] = State::UNTOUCHED;
+    }
+    touched_.clear();
+    first_slot_ = first_slot;
+    if (scores_.size() < slot_count) {
+        scores_.resize(slot_count, 0.0);
+        states_.resize(slot_count, State::UNTOUCHED);
+    }
+}
+
+ScoreAccumulator::Lease::Lease() {
+    if (accumulator_pool.in_use == accumulator_pool.accumulators.size()) {
+        accumulator_pool.accumulators.push_back(std::make_unique<ScoreAccumulator>());
+    }
+    accumulator_ = accumulator_pool.accumulators[accumulator_pool.in_use++].get();
+}
+
+ScoreAccumulator::Lease::~Lease() {
+    --accumulator_pool.in_use;
+}
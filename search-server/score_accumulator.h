@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense relevance accumulator over a range of document slots. Only the
+// touched entries are cleared, so a reused accumulator costs nothing per
+// untouched document.
+class ScoreAccumulator {
+public:
+    // Prepares the accumulator for slots in [first_slot, first_slot + slot_count)
+    void Reset(uint32_t first_slot, size_t slot_count);
+
+    void Add(uint32_t slot, double score) {
+        const size_t index = slot - first_slot_;
+        if (states_[index] == State::UNTOUCHED) {
+            states_[index] = State::SCORED;
+            touched_.push_back(slot);
+        }
+        scores_[index] += score;
+    }
+
+    // Excluded slots ignore further scores and are skipped by ForEachScored
+    void Exclude(uint32_t slot) {
+        const size_t index = slot - first_slot_;
+        if (states_[index] == State::UNTOUCHED) {
+            touched_.push_back(slot);
+        }
+        states_[index] = State::EXCLUDED;
+    }
+
+    template <typename Function>
+    void ForEachScored(Function function) const {
+        for (const uint32_t slot : touched_) {
+            const size_t index = slot - first_slot_;
+            if (states_[index] == State::SCORED) {
+                function(slot, scores_[index]);
+            }
+        }
+    }
+
+    // Hands out an accumulator owned by the current thread until the lease ends
+    class Lease {
+    public:
+        Lease();
+        ~Lease();
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        ScoreAccumulator& operator*() const {
+            return *accumulator_;
+        }
+
+        ScoreAccumulator* operator->() const {
+            return accumulator_;
+        }
+
+    private:
+        ScoreAccumulator* accumulator_;
+    };
+
+private:
+    enum class State : uint8_t {
+        UNTOUCHED,
+        SCORED,
+        EXCLUDED,
+    };
+
+    uint32_t first_slot_ = 0;
+    std::vector<double> scores_;
+    std::vector<State> states_;
+    std::vector<uint32_t> touched_;
+};
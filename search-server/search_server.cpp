@@ -3,15 +3,45 @@
 #include <utility>
 #include <numeric>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <exception>
 
 using namespace std::string_literals;
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+namespace {
+constexpr size_t FORWARD_INDEX_BLOCK_SIZE = 256;
+
+template <typename Range, typename Function>
+void ForEachMaybeParallel(bool sequenced, Range& range, Function function) {
+    if (sequenced) {
+        std::for_each(std::execution::seq, range.begin(), range.end(), function);
+    }
+    else {
+        std::for_each(std::execution::par, range.begin(), range.end(), function);
+    }
+}
+
+MappableVector<char> CopyText(std::string_view text) {
+    return std::vector<char>(text.begin(), text.end());
+}
+}
+
+template <typename Words>
+bool SearchServer::TokenizeText(const std::string_view text, std::string& folded_text, Words& words) const {
+    if (!options_.tokenizer.fold_case) {
+        return Tokenize(text, words, options_.tokenizer.unicode_spaces);
+    }
+    FoldCase(text, folded_text);
+    return Tokenize(folded_text, words, options_.tokenizer.unicode_spaces);
+}
+
+SearchServer::SearchServer(const std::string& stop_words_text, SearchServerOptions options)
+    : SearchServer(SplitIntoWords(stop_words_text, options.tokenizer.unicode_spaces), options)
 {
 }
-SearchServer::SearchServer(const std::string_view stop_words_text_view)
-    : SearchServer(SplitIntoWords(stop_words_text_view))
+SearchServer::SearchServer(const std::string_view stop_words_text_view, SearchServerOptions options)
+    : SearchServer(SplitIntoWords(stop_words_text_view, options.tokenizer.unicode_spaces), options)
 {
 }
 
@@ -23,28 +53,354 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
     if (documents_.count(document_id)) {
         throw std::invalid_argument("Document with this id already exists"s);
     }
-    if (!IsValidWord(document)) {
+    std::string folded_document;
+    std::vector<std::string_view> words;
+    if (!TokenizeText(document, folded_document, words)) {
         throw std::invalid_argument("Document must not contain special characters"s);
     }
-
-    const auto [iter, success] = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, std::string(document) });
-    const auto words = SplitIntoWordsNoStop(iter->second.document_content);
+    words.erase(std::remove_if(words.begin(), words.end(), [this](const std::string_view word) {
+        return IsStopWord(word);
+        }), words.end());
 
     const double inv_word_count = 1.0 / words.size();
+    std::vector<TermId> term_ids;
+    term_ids.reserve(words.size());
     for (const std::string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        id_to_word_freqs[document_id][word] += inv_word_count;
+        const TermId term_id = lexicon_.Intern(word);
+        if (term_id == term_stats_.size()) {
+            term_stats_.emplace_back();
+        }
+        term_ids.push_back(term_id);
     }
+    // Occurrences are counted on sorted ids, postings store counts and the frequency is derived from them
+    std::sort(term_ids.begin(), term_ids.end());
+    std::vector<std::pair<TermId, uint32_t>> term_counts;
+    for (const TermId term_id : term_ids) {
+        if (term_counts.empty() || term_counts.back().first != term_id) {
+            term_counts.emplace_back(term_id, 0);
+        }
+        ++term_counts.back().second;
+    }
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    // A document with a term the lexicon did not have duplicates nothing, so a rejected one interned no terms
+    const WordSetFingerprint fingerprint = options_.duplicates != DuplicatePolicy::ALLOW
+        ? ComputeWordSetFingerprint(term_ids.data(), term_ids.data() + term_ids.size()) : WordSetFingerprint();
+    if (options_.duplicates == DuplicatePolicy::REJECT
+        && FindDocumentWithWords(fingerprint, term_ids.data(), term_ids.data() + term_ids.size(), document_id))
+    {
+        throw std::invalid_argument("Document duplicates an existing document"s);
+    }
+
+    const uint32_t slot = static_cast<uint32_t>(slot_to_document_id_.size());
+    documents_.emplace(document_id, DocumentData{
+        options_.retain_document_text ? CopyText(document) : MappableVector<char>(), slot });
+    for (const auto& [term_id, count] : term_counts) {
+        GetPostings(status, term_id).Add(slot, count, count * inv_word_count);
+        SetTermDocumentCount(term_id, term_stats_[term_id].document_count + 1);
+    }
+    if (options_.duplicates != DuplicatePolicy::ALLOW) {
+        fingerprint_documents_[fingerprint].push_back(document_id);
+    }
+    slot_terms_.push_back(AppendTerms(term_counts));
     document_index_.insert(document_id);
+    slot_to_document_id_.push_back(document_id);
+    slot_ratings_.push_back(ComputeAverageRating(ratings));
+    slot_statuses_.push_back(status);
+    slot_inv_word_counts_.push_back(inv_word_count);
+    dead_slots_.push_back(false);
+    UpdateLogDocumentCount();
+    ++epoch_;
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddPreparedBatch(PrepareDocumentBatch(documents, true), true);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents) {
+    AddPreparedBatch(PrepareDocumentBatch(documents, true), true);
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents) {
+    AddPreparedBatch(PrepareDocumentBatch(documents, false), false);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy&, PreparedDocuments&& documents) {
+    AddPreparedBatch(std::move(documents), true);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const
+void SearchServer::AddDocuments(const std::execution::parallel_policy&, PreparedDocuments&& documents) {
+    AddPreparedBatch(std::move(documents), false);
+}
+
+SearchServer::PreparedDocuments SearchServer::PrepareDocuments(const std::execution::sequenced_policy&,
+    const std::vector<NewDocument>& documents) const
 {
-    return FindTopDocuments(std::execution::seq,
-        raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-        {
-            return document_status == status;
+    return PrepareDocumentBatch(documents, true);
+}
+
+SearchServer::PreparedDocuments SearchServer::PrepareDocuments(const std::execution::parallel_policy&,
+    const std::vector<NewDocument>& documents) const
+{
+    return PrepareDocumentBatch(documents, false);
+}
+
+SearchServer::PreparedDocuments SearchServer::PrepareDocumentBatch(const std::vector<NewDocument>& documents, bool sequenced) const {
+    PreparedDocuments prepared;
+    const size_t part_count = sequenced ? 1
+        : std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), documents.size()));
+    prepared.parts.resize(part_count);
+    for (size_t part_index = 0; part_index < part_count; ++part_index) {
+        prepared.parts[part_index].first_document = documents.size() * part_index / part_count;
+        prepared.parts[part_index].last_document = documents.size() * (part_index + 1) / part_count;
+    }
+    prepared.document_parts.resize(documents.size());
+    prepared.document_ids.resize(documents.size());
+    prepared.ratings.resize(documents.size());
+    prepared.statuses.resize(documents.size());
+    prepared.document_data.resize(documents.size());
+    prepared.document_terms.resize(documents.size());
+    prepared.inv_word_counts.resize(documents.size());
+
+    ForEachMaybeParallel(sequenced, prepared.parts, [&](PreparedDocuments::Part& part) {
+        // Position of a local term in document_terms of the last document it occurred in
+        std::vector<std::pair<size_t, size_t>> last_occurrence;
+        std::vector<std::string_view> words;
+        for (size_t i = part.first_document; i < part.last_document; ++i) {
+            const NewDocument& document = documents[i];
+            // The id is kept before tokenizing, so the ids up to an invalid document are checked first
+            prepared.document_ids[i] = document.id;
+            std::string& folded_text = part.folded_texts.emplace_back();
+            words.clear();
+            if (!TokenizeText(document.text, folded_text, words)) {
+                part.first_invalid_document = i;
+                return;
+            }
+            auto& document_terms = prepared.document_terms[i];
+            size_t word_count = 0;
+            for (const std::string_view word : words) {
+                if (IsStopWord(word)) {
+                    continue;
+                }
+                ++word_count;
+                const auto [iter, inserted] = part.term_to_local_id.emplace(word, static_cast<uint32_t>(part.terms.size()));
+                if (inserted) {
+                    part.terms.push_back(word);
+                    part.postings.emplace_back();
+                    part.term_statuses.push_back(0);
+                    last_occurrence.emplace_back(documents.size(), 0);
+                }
+                auto& [last_document, position] = last_occurrence[iter->second];
+                if (last_document != i) {
+                    last_document = i;
+                    position = document_terms.size();
+                    document_terms.emplace_back(iter->second, 0);
+                }
+                ++document_terms[position].second;
+            }
+            prepared.inv_word_counts[i] = 1.0 / word_count;
+            for (const auto& [local_id, count] : document_terms) {
+                part.postings[local_id].emplace_back(static_cast<uint32_t>(i), count);
+                part.term_statuses[local_id] |= 1 << static_cast<int>(document.status);
+            }
+            prepared.document_parts[i] = static_cast<uint32_t>(&part - prepared.parts.data());
+            prepared.ratings[i] = ComputeAverageRating(document.ratings);
+            prepared.statuses[i] = document.status;
+            prepared.document_data[i] = { options_.retain_document_text ? CopyText(document.text) : MappableVector<char>(), 0 };
+        }
+        });
+    return prepared;
+}
+
+// Term ids come out in the order of first appearance like with AddDocument,
+// and postings of every part go after the ones of the previous parts
+void SearchServer::AddPreparedBatch(PreparedDocuments&& prepared, bool sequenced) {
+    // Documents are checked in batch order, so the error is the one consecutive AddDocument calls give.
+    // A part stops at its first invalid document and parts go in batch order.
+    std::optional<size_t> first_invalid_document;
+    for (const PreparedDocuments::Part& part : prepared.parts) {
+        if (part.first_invalid_document) {
+            first_invalid_document = part.first_invalid_document;
+            break;
+        }
+    }
+    const size_t checked_count = first_invalid_document ? *first_invalid_document + 1 : prepared.document_ids.size();
+    std::unordered_set<int> batch_ids;
+    batch_ids.reserve(checked_count);
+    for (size_t i = 0; i < checked_count; ++i) {
+        const int document_id = prepared.document_ids[i];
+        if (document_id < 0) {
+            throw std::invalid_argument("Document id must be non-negative"s);
+        }
+        if (documents_.count(document_id) || !batch_ids.insert(document_id).second) {
+            throw std::invalid_argument("Document with this id already exists"s);
+        }
+    }
+    if (first_invalid_document) {
+        throw std::invalid_argument("Document must not contain special characters"s);
+    }
+
+    // Only the lexicon is merged serially, one lookup per distinct term of a part. New terms get
+    // the ids interning them in this order gives, but are interned only once the batch is accepted.
+    auto& parts = prepared.parts;
+    std::vector<std::vector<TermId>> local_to_term_id(parts.size());
+    std::vector<std::tuple<TermId, uint32_t, uint32_t>> term_sources;
+    std::unordered_map<std::string_view, TermId> new_term_ids;
+    std::vector<std::string_view> new_terms;
+    for (size_t part_index = 0; part_index < parts.size(); ++part_index) {
+        for (const std::string_view term : parts[part_index].terms) {
+            TermId term_id = lexicon_.Find(term);
+            if (term_id == Lexicon::NO_TERM) {
+                const auto [iter, inserted] = new_term_ids.emplace(term, static_cast<TermId>(lexicon_.size() + new_terms.size()));
+                if (inserted) {
+                    new_terms.push_back(term);
+                }
+                term_id = iter->second;
+            }
+            term_sources.emplace_back(term_id, static_cast<uint32_t>(part_index),
+                static_cast<uint32_t>(local_to_term_id[part_index].size()));
+            local_to_term_id[part_index].push_back(term_id);
+        }
+    }
+
+    const uint32_t first_slot = static_cast<uint32_t>(slot_to_document_id_.size());
+    const auto& inv_word_counts = prepared.inv_word_counts;
+    // Every document gets its range of the forward index up front, so the ranges are filled in parallel.
+    // The ranges start at the batch and are moved to the end of the index once no duplicate is rejected.
+    std::vector<TermRange> term_ranges(prepared.document_ids.size());
+    uint64_t batch_size = 0;
+    for (size_t i = 0; i < prepared.document_ids.size(); ++i) {
+        term_ranges[i] = { batch_size, batch_size + prepared.document_terms[i].size() };
+        batch_size = term_ranges[i].last;
+    }
+    std::vector<TermId> batch_terms(batch_size);
+    std::vector<uint32_t> batch_counts(batch_size);
+
+    // Split by documents rather than by parts, a batch prepared in one part is still built in parallel
+    std::vector<size_t> document_blocks;
+    for (size_t i = 0; i < prepared.document_ids.size(); i += FORWARD_INDEX_BLOCK_SIZE) {
+        document_blocks.push_back(i);
+    }
+    const bool indexes_fingerprints = options_.duplicates != DuplicatePolicy::ALLOW;
+    std::vector<WordSetFingerprint> fingerprints(indexes_fingerprints ? prepared.document_ids.size() : 0);
+    ForEachMaybeParallel(sequenced, document_blocks, [&](size_t first_document) {
+        const size_t last_document = std::min(first_document + FORWARD_INDEX_BLOCK_SIZE, prepared.document_ids.size());
+        std::vector<std::pair<TermId, uint32_t>> term_counts;
+        for (size_t i = first_document; i < last_document; ++i) {
+            const auto& term_ids = local_to_term_id[prepared.document_parts[i]];
+            prepared.document_data[i].slot = first_slot + static_cast<uint32_t>(i);
+            term_counts.clear();
+            for (const auto& [local_id, count] : prepared.document_terms[i]) {
+                term_counts.emplace_back(term_ids[local_id], count);
+            }
+            std::sort(term_counts.begin(), term_counts.end());
+            uint64_t position = term_ranges[i].first;
+            for (const auto& [term_id, count] : term_counts) {
+                batch_terms[position] = term_id;
+                batch_counts[position] = count;
+                ++position;
+            }
+            if (indexes_fingerprints) {
+                fingerprints[i] = ComputeWordSetFingerprint(batch_terms.data() + term_ranges[i].first,
+                    batch_terms.data() + term_ranges[i].last);
+            }
+        }
+        });
+
+    // Duplicates are looked for in the index and among the earlier documents of the batch
+    if (options_.duplicates == DuplicatePolicy::REJECT) {
+        const auto first_term = [&](size_t i) { return batch_terms.data() + term_ranges[i].first; };
+        const auto last_term = [&](size_t i) { return batch_terms.data() + term_ranges[i].last; };
+        std::unordered_map<WordSetFingerprint, std::vector<size_t>, WordSetFingerprintHash> batch_fingerprints;
+        for (size_t i = 0; i < prepared.document_ids.size(); ++i) {
+            auto& same_fingerprint = batch_fingerprints[fingerprints[i]];
+            if (FindDocumentWithWords(fingerprints[i], first_term(i), last_term(i), prepared.document_ids[i])
+                || std::any_of(same_fingerprint.begin(), same_fingerprint.end(), [&](size_t other) {
+                    return std::equal(first_term(i), last_term(i), first_term(other), last_term(other));
+                    }))
+            {
+                throw std::invalid_argument("Document duplicates an existing document"s);
+            }
+            same_fingerprint.push_back(i);
+        }
+    }
+
+    for (const std::string_view term : new_terms) {
+        lexicon_.Intern(term);
+        term_stats_.emplace_back();
+    }
+    // Lists are created here, so the parallel appends below only look them up
+    for (size_t part_index = 0; part_index < parts.size(); ++part_index) {
+        for (size_t local_id = 0; local_id < parts[part_index].terms.size(); ++local_id) {
+            for (size_t status = 0; status < STATUS_COUNT; ++status) {
+                if (parts[part_index].term_statuses[local_id] & (1 << status)) {
+                    GetPostings(static_cast<DocumentStatus>(status), local_to_term_id[part_index][local_id]);
+                }
+            }
+        }
+    }
+    const uint64_t old_forward_size = forward_terms_.size();
+    for (TermRange& range : term_ranges) {
+        range = { old_forward_size + range.first, old_forward_size + range.last };
+    }
+    auto& forward_terms = forward_terms_.Mutable();
+    auto& forward_counts = forward_counts_.Mutable();
+    forward_terms.insert(forward_terms.end(), batch_terms.begin(), batch_terms.end());
+    forward_counts.insert(forward_counts.end(), batch_counts.begin(), batch_counts.end());
+
+    // Every posting list is appended by one task, parts in batch order
+    std::stable_sort(term_sources.begin(), term_sources.end(), [](const auto& lhs, const auto& rhs) {
+        return std::get<0>(lhs) < std::get<0>(rhs);
+        });
+    std::vector<size_t> term_starts;
+    for (size_t i = 0; i < term_sources.size(); ++i) {
+        if (i == 0 || std::get<0>(term_sources[i]) != std::get<0>(term_sources[i - 1])) {
+            term_starts.push_back(i);
+        }
+    }
+    ForEachMaybeParallel(sequenced, term_starts, [&](size_t start) {
+        const TermId term_id = std::get<0>(term_sources[start]);
+        uint32_t document_count = term_stats_[term_id].document_count;
+        for (size_t i = start; i < term_sources.size() && std::get<0>(term_sources[i]) == term_id; ++i) {
+            const auto [source_term_id, part_index, local_id] = term_sources[i];
+            for (const auto& [document, count] : parts[part_index].postings[local_id]) {
+                GetPostings(prepared.statuses[document], term_id)
+                    .Add(first_slot + document, count, count * inv_word_counts[document]);
+            }
+            document_count += static_cast<uint32_t>(parts[part_index].postings[local_id].size());
+        }
+        SetTermDocumentCount(term_id, document_count);
+        });
+
+    slot_to_document_id_.insert(slot_to_document_id_.end(), prepared.document_ids.begin(), prepared.document_ids.end());
+    slot_ratings_.insert(slot_ratings_.end(), prepared.ratings.begin(), prepared.ratings.end());
+    slot_statuses_.insert(slot_statuses_.end(), prepared.statuses.begin(), prepared.statuses.end());
+    slot_inv_word_counts_.insert(slot_inv_word_counts_.end(), inv_word_counts.begin(), inv_word_counts.end());
+    slot_terms_.insert(slot_terms_.end(), term_ranges.begin(), term_ranges.end());
+    dead_slots_.resize(slot_to_document_id_.size(), false);
+    // Documents go in id order, so every hint after the first is usually exact
+    std::vector<size_t> id_order(prepared.document_ids.size());
+    std::iota(id_order.begin(), id_order.end(), 0);
+    std::sort(id_order.begin(), id_order.end(), [&prepared](size_t lhs, size_t rhs) {
+        return prepared.document_ids[lhs] < prepared.document_ids[rhs];
         });
+    for (size_t i = 0; i < fingerprints.size(); ++i) {
+        fingerprint_documents_[fingerprints[i]].push_back(prepared.document_ids[i]);
+    }
+    auto documents_hint = documents_.begin();
+    auto index_hint = document_index_.begin();
+    for (const size_t i : id_order) {
+        const int document_id = prepared.document_ids[i];
+        documents_hint = std::next(documents_.emplace_hint(documents_hint, document_id, std::move(prepared.document_data[i])));
+        index_hint = std::next(document_index_.emplace_hint(index_hint, document_id));
+    }
+    UpdateLogDocumentCount();
+    ++epoch_;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+    size_t max_result_count) const
+{
+    return FindTopDocuments(std::execution::seq, raw_query, status, max_result_count);
 }
 
 
@@ -53,111 +409,504 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query)
     return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+SearchPage SearchServer::FindTopDocumentsPage(std::string_view raw_query, DocumentStatus status,
+    size_t page_size, const std::optional<SearchCursor>& after) const
+{
+    return FindDocumentPage(std::execution::seq, raw_query, StatusFilter{ status }, page_size, after);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query,
+    DocumentStatus status, size_t max_result_count) const
+{
+    const auto query = ParseQuery(raw_query, context);
+
+    return FindAllDocuments(std::execution::seq, query, StatusFilter{ status }, max_result_count);
+}
+
+SearchServer::ParsedQuery SearchServer::PrepareQuery(std::string_view raw_query) const {
+    ParsedQuery query;
+    query.query = ParseQuery(raw_query);
+    return query;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const ParsedQuery& query, DocumentStatus status,
+    size_t max_result_count) const
+{
+    return FindAllDocuments(std::execution::seq, query.query, StatusFilter{ status }, max_result_count);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+    DocumentStatus status, size_t max_result_count) const
+{
+    // Equal texts are parsed once
+    std::unordered_map<std::string_view, size_t> text_indexes;
+    std::vector<std::string_view> texts;
+    std::vector<size_t> query_texts(raw_queries.size());
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        const auto [iter, inserted] = text_indexes.emplace(raw_queries[i], texts.size());
+        if (inserted) {
+            texts.push_back(raw_queries[i]);
+        }
+        query_texts[i] = iter->second;
+    }
+
+    // An exception must not leave a parallel algorithm, the first invalid query in the batch is reported
+    std::vector<Query> queries(texts.size());
+    std::vector<std::exception_ptr> errors(texts.size());
+    std::vector<size_t> text_order(texts.size());
+    std::iota(text_order.begin(), text_order.end(), 0);
+    std::for_each(std::execution::par, text_order.begin(), text_order.end(), [&](size_t text) {
+        try {
+            queries[text] = ParseQuery(texts[text]);
+        }
+        catch (...) {
+            errors[text] = std::current_exception();
+        }
+        });
+    for (const size_t text : query_texts) {
+        if (errors[text]) {
+            std::rethrow_exception(errors[text]);
+        }
+    }
+
+    // Texts that differ only in word order, repeated words or unknown words share one search
+    std::unordered_map<std::string, size_t> key_indexes;
+    std::vector<size_t> searched_texts;
+    std::vector<size_t> text_searches(texts.size());
+    for (size_t text = 0; text < texts.size(); ++text) {
+        const auto [iter, inserted] = key_indexes.emplace(MakeQueryKey(queries[text]), searched_texts.size());
+        if (inserted) {
+            searched_texts.push_back(text);
+        }
+        text_searches[text] = iter->second;
+    }
+    std::vector<std::vector<Document>> search_results(searched_texts.size());
+    std::vector<size_t> search_order(searched_texts.size());
+    std::iota(search_order.begin(), search_order.end(), 0);
+    std::for_each(std::execution::par, search_order.begin(), search_order.end(), [&](size_t search) {
+        search_results[search] = FindAllDocuments(std::execution::seq, queries[searched_texts[search]],
+            StatusFilter{ status }, max_result_count);
+        });
+
+    std::vector<std::vector<Document>> results(raw_queries.size());
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        results[i] = search_results[text_searches[query_texts[i]]];
+    }
+    return results;
+}
+
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
-{
-    static std::map<std::string_view, double> word_freqs;
-    if (!id_to_word_freqs.count(document_id)) {
-        return word_freqs;
+double SearchServer::GetInverseDocumentFreq(std::string_view word) const {
+    const std::string folded_word = options_.tokenizer.fold_case ? FoldCase(word) : std::string();
+    const TermId term_id = lexicon_.Find(options_.tokenizer.fold_case ? std::string_view(folded_word) : word);
+    if (term_id == Lexicon::NO_TERM || term_stats_[term_id].document_count == 0) {
+        return 0.0;
     }
-    return id_to_word_freqs.at(document_id);
+    return ComputeWordInverseDocumentFreq(term_id);
 }
 
-SearchServer::MatchResult SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
-    if (document_index_.count(document_id) == 0) {
+uint64_t SearchServer::GetEpoch() const {
+    return epoch_;
+}
+
+std::string SearchServer::GetQueryKey(std::string_view raw_query) const {
+    return MakeQueryKey(ParseQuery(raw_query));
+}
+
+std::string SearchServer::GetQueryKey(const ParsedQuery& query) const {
+    return MakeQueryKey(query.query);
+}
+
+std::string SearchServer::MakeQueryKey(const Query& query) {
+    // The number of plus words separates them from the minus words
+    std::string key;
+    const uint32_t plus_word_count = static_cast<uint32_t>(query.plus_words.size());
+    key.append(reinterpret_cast<const char*>(&plus_word_count), sizeof(plus_word_count));
+    key.append(reinterpret_cast<const char*>(query.plus_words.data()), query.plus_words.size() * sizeof(TermId));
+    key.append(reinterpret_cast<const char*>(query.minus_words.data()), query.minus_words.size() * sizeof(TermId));
+    return key;
+}
+
+std::string_view SearchServer::GetDocumentText(int document_id) const {
+    const auto iter = documents_.find(document_id);
+    if (iter == documents_.end()) {
         throw std::out_of_range("Not valid document id"s);
     }
-    const auto query = ParseQuery(raw_query);
+    return iter->second.GetContent();
+}
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { {}, documents_.at(document_id).status };
-        }
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const
+{
+    std::map<std::string_view, double> word_freqs;
+    const auto iter = documents_.find(document_id);
+    if (iter == documents_.end()) {
+        return word_freqs;
     }
-    std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    const uint32_t slot = iter->second.slot;
+    for (uint64_t term = slot_terms_[slot].first; term < slot_terms_[slot].last; ++term) {
+        word_freqs.emplace(lexicon_.GetTerm(forward_terms_[term]), forward_counts_[term] * slot_inv_word_counts_[slot]);
+    }
+    return word_freqs;
+}
+
+WordSetFingerprint SearchServer::GetWordSetFingerprint(int document_id) const {
+    const uint32_t slot = GetDocumentSlot(document_id);
+    return ComputeWordSetFingerprint(GetFirstTerm(slot), GetLastTerm(slot));
+}
+
+bool SearchServer::HaveSameWords(int lhs_document_id, int rhs_document_id) const {
+    const uint32_t lhs_slot = GetDocumentSlot(lhs_document_id);
+    const uint32_t rhs_slot = GetDocumentSlot(rhs_document_id);
+    return std::equal(GetFirstTerm(lhs_slot), GetLastTerm(lhs_slot), GetFirstTerm(rhs_slot), GetLastTerm(rhs_slot));
+}
+
+double SearchServer::GetWordSetSimilarity(int lhs_document_id, int rhs_document_id) const {
+    const uint32_t lhs_slot = GetDocumentSlot(lhs_document_id);
+    const uint32_t rhs_slot = GetDocumentSlot(rhs_document_id);
+    const size_t lhs_size = GetLastTerm(lhs_slot) - GetFirstTerm(lhs_slot);
+    const size_t rhs_size = GetLastTerm(rhs_slot) - GetFirstTerm(rhs_slot);
+    if (lhs_size == 0 && rhs_size == 0) {
+        return 1.0;
+    }
+    // Both ranges are sorted, so the common terms are found by one merge
+    size_t common_count = 0;
+    const TermId* lhs_term = GetFirstTerm(lhs_slot);
+    const TermId* rhs_term = GetFirstTerm(rhs_slot);
+    while (lhs_term != GetLastTerm(lhs_slot) && rhs_term != GetLastTerm(rhs_slot)) {
+        if (*lhs_term < *rhs_term) {
+            ++lhs_term;
+        }
+        else if (*rhs_term < *lhs_term) {
+            ++rhs_term;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        else {
+            ++common_count;
+            ++lhs_term;
+            ++rhs_term;
         }
     }
+    return static_cast<double>(common_count) / (lhs_size + rhs_size - common_count);
+}
 
-    return { matched_words, documents_.at(document_id).status };
+std::vector<TermId> SearchServer::GetDocumentTerms(int document_id) const {
+    const uint32_t slot = GetDocumentSlot(document_id);
+    return std::vector<TermId>(GetFirstTerm(slot), GetLastTerm(slot));
+}
+
+std::optional<int> SearchServer::FindDuplicate(int document_id) const {
+    const uint32_t slot = GetDocumentSlot(document_id);
+    if (options_.duplicates == DuplicatePolicy::ALLOW) {
+        return std::nullopt;
+    }
+    return FindDocumentWithWords(ComputeWordSetFingerprint(GetFirstTerm(slot), GetLastTerm(slot)),
+        GetFirstTerm(slot), GetLastTerm(slot), document_id);
+}
+
+SearchServer::MatchResult SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    QueryContext context;
+    return MatchDocument(context, raw_query, document_id);
+}
+
+SearchServer::MatchResult SearchServer::MatchDocument(QueryContext& context, const std::string_view raw_query, int document_id) const {
+    const uint32_t slot = GetDocumentSlot(document_id);
+    const auto query = ParseQuery(raw_query, context);
+
+    return MatchSlot(query, slot);
 }
 SearchServer::MatchResult SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const {
     return SearchServer::MatchDocument(raw_query, document_id);
 }
 SearchServer::MatchResult SearchServer::MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const {
-    if (document_index_.count(document_id) == 0) {
-        throw std::out_of_range("Not valid document id"s);
-    }
+    const uint32_t slot = GetDocumentSlot(document_id);
     auto query = ParseQuery(raw_query, false);
+    const DocumentStatus status = slot_statuses_[slot];
 
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&](const std::string_view word) {
-        return (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)); }))
+    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&](const TermId word) {
+        return DocumentHasTerm(slot, word); }))
     {
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, status };
     }
 
-    std::vector<std::string_view> matched_words(query.plus_words.size());
+    std::vector<TermId> matched_terms(query.plus_words.size());
 
-    auto iter = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](const std::string_view word) {
-        return (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id));
+    auto iter = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_terms.begin(), [&](const TermId word) {
+        return DocumentHasTerm(slot, word);
         });
 
-    matched_words.erase(iter, matched_words.end());
+    matched_terms.erase(iter, matched_terms.end());
+
+    std::sort(matched_terms.begin(), matched_terms.end());
+    auto it_del = std::unique(matched_terms.begin(), matched_terms.end());
+    matched_terms.erase(it_del, matched_terms.end());
 
+    std::vector<std::string_view> matched_words(matched_terms.size());
+    std::transform(matched_terms.begin(), matched_terms.end(), matched_words.begin(), [&](const TermId word) {
+        return lexicon_.GetTerm(word);
+        });
     std::sort(matched_words.begin(), matched_words.end());
-    auto it_del = std::unique(matched_words.begin(), matched_words.end());
-    matched_words.erase(it_del, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, status };
 }
-void SearchServer::RemoveDocument(int document_id)
+
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const std::string_view raw_query,
+    const std::vector<int>& document_ids) const
 {
-    if (!id_to_word_freqs.count(document_id)) { return; }
-    auto& word_freq = id_to_word_freqs.at(document_id);
-    for (auto iter = word_freq.begin(); iter != word_freq.end(); iter++) {
-        auto it_del = word_to_document_freqs_.find(iter->first);
-        (it_del->second.size() == 1) ? (void)word_to_document_freqs_.erase(it_del) : (void)it_del->second.erase(document_id);
+    return MatchDocumentBatch(raw_query, document_ids, true);
+}
+
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const std::execution::sequenced_policy&,
+    const std::string_view raw_query, const std::vector<int>& document_ids) const
+{
+    return MatchDocumentBatch(raw_query, document_ids, true);
+}
+
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const std::execution::parallel_policy&,
+    const std::string_view raw_query, const std::vector<int>& document_ids) const
+{
+    return MatchDocumentBatch(raw_query, document_ids, false);
+}
+
+// Ids are checked before matching, so no exception leaves the parallel algorithm
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocumentBatch(const std::string_view raw_query,
+    const std::vector<int>& document_ids, bool sequenced) const
+{
+    std::vector<uint32_t> slots(document_ids.size());
+    std::transform(document_ids.begin(), document_ids.end(), slots.begin(), [this](int document_id) {
+        return GetDocumentSlot(document_id);
+        });
+    const auto query = ParseQuery(raw_query);
+
+    std::vector<MatchResult> results(slots.size());
+    const auto match_slot = [this, &query](uint32_t slot) {
+        return MatchSlot(query, slot);
+    };
+    if (sequenced) {
+        std::transform(std::execution::seq, slots.begin(), slots.end(), results.begin(), match_slot);
     }
-    id_to_word_freqs.erase(document_id);
-    documents_.erase(document_id);
-    document_index_.erase(document_id);
+    else {
+        std::transform(std::execution::par, slots.begin(), slots.end(), results.begin(), match_slot);
+    }
+    return results;
+}
+
+void SearchServer::RemoveDocument(int document_id)
+{
+    RemoveDocument(document_id, true);
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id)
 {
-    RemoveDocument(document_id);
+    RemoveDocument(document_id, true);
 }
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
-    if (!id_to_word_freqs.count(document_id)) { return; }
-    auto& word_freq = id_to_word_freqs.at(document_id);
-    std::vector <std::string_view> v(word_freq.size());
-    std::transform(std::execution::par,
-        word_freq.begin(),
-        word_freq.end(),
-        v.begin(),
-        [&](const auto& word) {
-            return word.first;
-        });
-    std::mutex mutex_;
-    std::for_each(std::execution::par, v.begin(), v.end(), [&](const auto word) {
-        const std::lock_guard<std::mutex> lock(mutex_);
-        word_to_document_freqs_.at(word).erase(document_id);
-        });
-    id_to_word_freqs.erase(document_id);
-    documents_.erase(document_id);
-    document_index_.erase(document_id);
+    RemoveDocument(document_id, false);
 }
+
+bool SearchServer::NeedsCompaction() const {
+    return dead_slot_count_ > 0
+        && dead_slot_count_ >= options_.compaction.min_dead_documents
+        && dead_slot_count_ >= options_.compaction.min_dead_fraction * slot_to_document_id_.size();
+}
+
+void SearchServer::Compact() {
+    CompactSlots(true);
+}
+
+void SearchServer::Compact(const std::execution::sequenced_policy&) {
+    CompactSlots(true);
+}
+
+void SearchServer::Compact(const std::execution::parallel_policy&) {
+    CompactSlots(false);
+}
+
+// Postings are sorted by slot, so the document is appended under a new slot
+void SearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    const auto iter = documents_.find(document_id);
+    if (iter == documents_.end()) {
+        throw std::out_of_range("Not valid document id"s);
+    }
+    DocumentData& document_data = iter->second;
+    if (slot_statuses_[document_data.slot] == status) {
+        return;
+    }
+    const uint32_t slot = static_cast<uint32_t>(slot_to_document_id_.size());
+    const double inv_word_count = slot_inv_word_counts_[document_data.slot];
+    const TermRange terms = slot_terms_[document_data.slot];
+    for (uint64_t term = terms.first; term < terms.last; ++term) {
+        const uint32_t count = forward_counts_[term];
+        GetPostings(status, forward_terms_[term]).Add(slot, count, count * inv_word_count);
+    }
+    dead_slots_[document_data.slot] = true;
+    ++dead_slot_count_;
+    slot_to_document_id_.push_back(document_id);
+    slot_ratings_.push_back(slot_ratings_[document_data.slot]);
+    slot_statuses_.push_back(status);
+    slot_inv_word_counts_.push_back(inv_word_count);
+    // The new slot shares the forward index range of the old one
+    slot_terms_.push_back(terms);
+    dead_slots_.push_back(false);
+    document_data.slot = slot;
+    ++epoch_;
+    if (options_.compaction.automatic && NeedsCompaction()) {
+        CompactSlots(true);
+    }
+}
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+    const uint8_t flags[] = { options_.tokenizer.unicode_spaces, options_.tokenizer.fold_case, options_.retain_document_text,
+        static_cast<uint8_t>(options_.duplicates) };
+    writer.WriteArray(flags, std::size(flags));
+    writer.WriteStrings(std::vector<std::string_view>(stop_words_.begin(), stop_words_.end()));
+    lexicon_.Save(writer);
+    for (const StatusPostings& partition : status_postings_) {
+        writer.WriteArray(partition.term_lists);
+        const uint64_t list_count = partition.lists.size();
+        writer.WriteArray(&list_count, 1);
+        for (const PostingList& postings : partition.lists) {
+            postings.Save(writer);
+        }
+    }
+    writer.WriteArray(slot_to_document_id_);
+    writer.WriteArray(slot_inv_word_counts_);
+
+    // The forward index is saved without the ranges of dead slots, as per-document runs in id order
+    std::vector<SnapshotDocument> documents;
+    std::vector<std::string_view> texts;
+    std::vector<TermId> terms;
+    std::vector<uint32_t> counts;
+    for (const auto& [document_id, document_data] : documents_) {
+        const TermRange range = slot_terms_[document_data.slot];
+        documents.push_back({ document_id, slot_ratings_[document_data.slot],
+            static_cast<int32_t>(slot_statuses_[document_data.slot]), document_data.slot, range.last - range.first });
+        texts.push_back(document_data.GetContent());
+        terms.insert(terms.end(), forward_terms_.begin() + range.first, forward_terms_.begin() + range.last);
+        counts.insert(counts.end(), forward_counts_.begin() + range.first, forward_counts_.begin() + range.last);
+    }
+    writer.WriteArray(documents);
+    writer.WriteStrings(texts);
+    writer.WriteArray(terms);
+    writer.WriteArray(counts);
+    writer.Finish();
+}
+
+SearchServer SearchServer::OpenSnapshot(const std::string& path, bool verify_checksum) {
+    auto snapshot = std::make_shared<const MappedFile>(path);
+    SnapshotReader reader(snapshot->data(), snapshot->size(), verify_checksum);
+    const auto flags = reader.ReadArray<uint8_t>();
+    if (flags.size() != 4 || flags[3] > static_cast<uint8_t>(DuplicatePolicy::FLAG)) {
+        SnapshotReader::ThrowCorrupted();
+    }
+    SearchServerOptions options;
+    options.tokenizer.unicode_spaces = flags[0] != 0;
+    options.tokenizer.fold_case = flags[1] != 0;
+    options.retain_document_text = flags[2] != 0;
+    options.duplicates = static_cast<DuplicatePolicy>(flags[3]);
+
+    SearchServer server(reader.ReadStrings(), options);
+    server.snapshot_ = snapshot;
+    server.lexicon_.Load(reader);
+    for (StatusPostings& partition : server.status_postings_) {
+        const auto term_lists = reader.ReadArray<uint32_t>();
+        const auto list_count = reader.ReadArray<uint64_t>();
+        if (term_lists.size() > server.lexicon_.size() || list_count.size() != 1) {
+            SnapshotReader::ThrowCorrupted();
+        }
+        partition.term_lists.assign(term_lists.begin(), term_lists.end());
+        for (const uint32_t list : partition.term_lists) {
+            if (list != StatusPostings::NO_LIST && list >= list_count[0]) {
+                SnapshotReader::ThrowCorrupted();
+            }
+        }
+        partition.lists.reserve(list_count[0]);
+        for (uint64_t list = 0; list < list_count[0]; ++list) {
+            partition.lists.push_back(PostingList::Load(reader));
+        }
+    }
+    const auto slot_to_document_id = reader.ReadArray<int>();
+    const auto slot_inv_word_counts = reader.ReadArray<double>();
+    if (slot_to_document_id.size() != slot_inv_word_counts.size()
+        || slot_to_document_id.size() > std::numeric_limits<uint32_t>::max())
+    {
+        SnapshotReader::ThrowCorrupted();
+    }
+    // Postings index the slot columns directly. Decoding every list reads the whole file,
+    // which the checksum verification does anyway.
+    for (const StatusPostings& partition : server.status_postings_) {
+        for (const PostingList& postings : partition.lists) {
+            if (!postings.HasSlotsBelow(static_cast<uint32_t>(slot_to_document_id.size()), verify_checksum)) {
+                SnapshotReader::ThrowCorrupted();
+            }
+        }
+    }
+    server.slot_to_document_id_.assign(slot_to_document_id.begin(), slot_to_document_id.end());
+    server.slot_inv_word_counts_.assign(slot_inv_word_counts.begin(), slot_inv_word_counts.end());
+    server.slot_ratings_.assign(slot_to_document_id.size(), 0);
+    server.slot_statuses_.assign(slot_to_document_id.size(), DocumentStatus::ACTUAL);
+    server.slot_terms_.assign(slot_to_document_id.size(), TermRange());
+    // Dead postings are saved as they are, their slots are the ones no document refers to
+    server.dead_slots_.assign(slot_to_document_id.size(), true);
+    server.dead_slot_count_ = slot_to_document_id.size();
+    server.term_stats_.assign(server.lexicon_.size(), TermStats());
+
+    const auto documents = reader.ReadArray<SnapshotDocument>();
+    const auto texts = reader.ReadStrings();
+    auto terms = reader.ReadArray<TermId>();
+    auto counts = reader.ReadArray<uint32_t>();
+    if (texts.size() != documents.size() || terms.size() != counts.size() || !reader.AtEnd()) {
+        SnapshotReader::ThrowCorrupted();
+    }
+    uint64_t first_term = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const SnapshotDocument& document = documents[i];
+        // Ids must be unique, they were saved in ascending order
+        if ((i > 0 && documents[i - 1].id >= document.id)
+            || document.slot >= slot_to_document_id.size() || !server.dead_slots_[document.slot]
+            || slot_to_document_id[document.slot] != document.id
+            || document.word_count > terms.size() - first_term
+            || document.status < 0 || document.status > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+            SnapshotReader::ThrowCorrupted();
+        }
+        // Documents were saved in id order, so every insertion goes to the end
+        server.documents_.emplace_hint(server.documents_.end(), document.id,
+            DocumentData{ MappableVector<char>::View(texts[i].data(), texts[i].size()), document.slot });
+        server.slot_ratings_[document.slot] = document.rating;
+        server.slot_statuses_[document.slot] = static_cast<DocumentStatus>(document.status);
+        server.dead_slots_[document.slot] = false;
+        --server.dead_slot_count_;
+        server.document_index_.insert(server.document_index_.end(), document.id);
+        // Terms of a document must be sorted and unique, lookups search them by bisection
+        for (uint64_t term = first_term; term < first_term + document.word_count; ++term) {
+            if (terms[term] >= server.lexicon_.size() || counts[term] == 0
+                || (term > first_term && terms[term - 1] >= terms[term]))
+            {
+                SnapshotReader::ThrowCorrupted();
+            }
+            ++server.term_stats_[terms[term]].document_count;
+        }
+        server.slot_terms_[document.slot] = { first_term, first_term + document.word_count };
+        first_term += document.word_count;
+    }
+    server.forward_terms_ = std::move(terms);
+    server.forward_counts_ = std::move(counts);
+    for (TermId term_id = 0; term_id < server.term_stats_.size(); ++term_id) {
+        server.SetTermDocumentCount(term_id, server.term_stats_[term_id].document_count);
+    }
+    if (options.duplicates != DuplicatePolicy::ALLOW) {
+        for (const auto& [document_id, document_data] : server.documents_) {
+            const uint32_t slot = document_data.slot;
+            server.fingerprint_documents_[ComputeWordSetFingerprint(server.GetFirstTerm(slot), server.GetLastTerm(slot))]
+                .push_back(document_id);
+        }
+    }
+    server.UpdateLogDocumentCount();
+    return server;
+}
+
 bool SearchServer::IsStopWord(const std::string_view word) const {
     return stop_words_.count(word) > 0;
 }
@@ -169,19 +918,20 @@ bool SearchServer::IsValidWord(const std::string_view word) {
         });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (const std::string_view word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + word.data() + " is invalid"s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+std::set<std::string, std::less<>> SearchServer::FoldStopWords(std::set<std::string, std::less<>> stop_words,
+    TokenizerOptions tokenizer_options)
+{
+    if (!tokenizer_options.fold_case) {
+        return stop_words;
+    }
+    std::set<std::string, std::less<>> folded_stop_words;
+    for (const std::string& word : stop_words) {
+        folded_stop_words.insert(FoldCase(word));
     }
-    return words;
+    return folded_stop_words;
 }
 
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -200,23 +950,37 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw std::invalid_argument("Query word "s + text.data() + " is invalid");
+    if (word.empty() || word[0] == '-') {
+        throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
 
     return { word, is_minus, IsStopWord(word) };
 }
 SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool sequenced) const {
+    QueryContext context;
+    return ParseQuery(text, context, sequenced);
+}
+
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, QueryContext& context, bool sequenced) const {
+    context.words.clear();
+    if (!TokenizeText(text, context.folded_text, context.words)) {
+        throw std::invalid_argument("Query must not contain special characters"s);
+    }
     SearchServer::Query result;
-    for (const std::string_view word : SplitIntoWords(text)) {
+    for (const std::string_view word : context.words) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            }
-            else {
-                result.plus_words.push_back(query_word.data);
-            }
+        if (query_word.is_stop) {
+            continue;
+        }
+        const TermId term_id = lexicon_.Find(query_word.data);
+        if (term_id == Lexicon::NO_TERM) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            result.minus_words.push_back(term_id);
+        }
+        else {
+            result.plus_words.push_back(term_id);
         }
     }
     if (sequenced) {
@@ -232,6 +996,205 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool s
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+// The postings are left for compaction, queries skip the slot from now on
+void SearchServer::RemoveDocument(int document_id, bool sequenced) {
+    const auto iter = documents_.find(document_id);
+    if (iter == documents_.end()) {
+        return;
+    }
+    const uint32_t slot = iter->second.slot;
+    for (const TermId* term = GetFirstTerm(slot); term != GetLastTerm(slot); ++term) {
+        SetTermDocumentCount(*term, term_stats_[*term].document_count - 1);
+    }
+    if (options_.duplicates != DuplicatePolicy::ALLOW) {
+        const auto same_fingerprint = fingerprint_documents_.find(ComputeWordSetFingerprint(GetFirstTerm(slot), GetLastTerm(slot)));
+        auto& document_ids = same_fingerprint->second;
+        document_ids.erase(std::find(document_ids.begin(), document_ids.end(), document_id));
+        if (document_ids.empty()) {
+            fingerprint_documents_.erase(same_fingerprint);
+        }
+    }
+    dead_slots_[slot] = true;
+    ++dead_slot_count_;
+    documents_.erase(iter);
+    document_index_.erase(document_id);
+    UpdateLogDocumentCount();
+    ++epoch_;
+    if (options_.compaction.automatic && NeedsCompaction()) {
+        CompactSlots(sequenced);
+    }
+}
+
+void SearchServer::CompactSlots(bool sequenced) {
+    if (dead_slot_count_ == 0) {
+        return;
+    }
+    // Live slots keep their order, so renumbered postings stay sorted
+    std::vector<uint32_t> new_slots(slot_to_document_id_.size());
+    std::vector<int> slot_to_document_id;
+    std::vector<int> slot_ratings;
+    std::vector<DocumentStatus> slot_statuses;
+    std::vector<double> slot_inv_word_counts;
+    std::vector<TermRange> slot_terms;
+    std::vector<TermId> forward_terms;
+    std::vector<uint32_t> forward_counts;
+    const size_t live_slot_count = slot_to_document_id_.size() - dead_slot_count_;
+    slot_to_document_id.reserve(live_slot_count);
+    slot_ratings.reserve(live_slot_count);
+    slot_statuses.reserve(live_slot_count);
+    slot_inv_word_counts.reserve(live_slot_count);
+    slot_terms.reserve(live_slot_count);
+    for (uint32_t slot = 0; slot < slot_to_document_id_.size(); ++slot) {
+        if (!dead_slots_[slot]) {
+            new_slots[slot] = static_cast<uint32_t>(slot_to_document_id.size());
+            slot_to_document_id.push_back(slot_to_document_id_[slot]);
+            slot_ratings.push_back(slot_ratings_[slot]);
+            slot_statuses.push_back(slot_statuses_[slot]);
+            slot_inv_word_counts.push_back(slot_inv_word_counts_[slot]);
+            const TermRange range = slot_terms_[slot];
+            slot_terms.push_back({ forward_terms.size(), forward_terms.size() + (range.last - range.first) });
+            forward_terms.insert(forward_terms.end(), forward_terms_.begin() + range.first, forward_terms_.begin() + range.last);
+            forward_counts.insert(forward_counts.end(), forward_counts_.begin() + range.first, forward_counts_.begin() + range.last);
+        }
+    }
+
+    std::vector<PostingList*> lists;
+    for (StatusPostings& partition : status_postings_) {
+        for (PostingList& postings : partition.lists) {
+            lists.push_back(&postings);
+        }
+    }
+    ForEachMaybeParallel(sequenced, lists, [&](PostingList* postings) {
+        PostingList compacted;
+        postings->ForEach([&](uint32_t slot, uint32_t count) {
+            if (!dead_slots_[slot]) {
+                const uint32_t new_slot = new_slots[slot];
+                compacted.Add(new_slot, count, count * slot_inv_word_counts[new_slot]);
+            }
+            });
+        *postings = std::move(compacted);
+        });
+
+    for (auto& [document_id, document_data] : documents_) {
+        document_data.slot = new_slots[document_data.slot];
+    }
+    slot_to_document_id_ = std::move(slot_to_document_id);
+    slot_ratings_ = std::move(slot_ratings);
+    slot_statuses_ = std::move(slot_statuses);
+    slot_inv_word_counts_ = std::move(slot_inv_word_counts);
+    slot_terms_ = std::move(slot_terms);
+    forward_terms_ = std::move(forward_terms);
+    forward_counts_ = std::move(forward_counts);
+    dead_slots_.assign(slot_to_document_id_.size(), false);
+    dead_slot_count_ = 0;
+}
+
+void SearchServer::CheckPageSize(size_t page_size) {
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+}
+
+SearchPage SearchServer::MakeSearchPage(std::vector<Document> documents, size_t page_size) {
+    SearchPage page;
+    if (documents.size() > page_size) {
+        documents.resize(page_size);
+        const Document& last_document = documents.back();
+        page.next = SearchCursor{ last_document.relevance, last_document.rating, last_document.id };
+    }
+    page.documents = std::move(documents);
+    return page;
+}
+
+void SearchServer::SetTermDocumentCount(TermId term_id, uint32_t document_count) {
+    term_stats_[term_id] = { document_count, document_count > 0 ? log(document_count) : 0.0 };
+}
+
+void SearchServer::UpdateLogDocumentCount() {
+    log_document_count_ = documents_.empty() ? 0.0 : log(documents_.size());
+}
+
+WordSetFingerprint SearchServer::ComputeWordSetFingerprint(const TermId* first, const TermId* last) {
+    WordSetHasher hasher;
+    for (const TermId* term = first; term != last; ++term) {
+        hasher.Add(*term);
+    }
+    return hasher.Finish();
+}
+
+std::optional<int> SearchServer::FindDocumentWithWords(const WordSetFingerprint& fingerprint,
+    const TermId* first, const TermId* last, int excluded_id) const
+{
+    const auto iter = fingerprint_documents_.find(fingerprint);
+    if (iter == fingerprint_documents_.end()) {
+        return std::nullopt;
+    }
+    std::optional<int> result;
+    for (const int document_id : iter->second) {
+        if (document_id != excluded_id && (!result || document_id < *result)
+            && std::equal(first, last, GetFirstTerm(documents_.at(document_id).slot),
+                GetLastTerm(documents_.at(document_id).slot)))
+        {
+            result = document_id;
+        }
+    }
+    return result;
+}
+
+PostingList& SearchServer::GetPostings(DocumentStatus status, TermId term_id) {
+    StatusPostings& partition = status_postings_[static_cast<size_t>(status)];
+    if (term_id >= partition.term_lists.size()) {
+        partition.term_lists.resize(term_id + 1, StatusPostings::NO_LIST);
+    }
+    if (partition.term_lists[term_id] == StatusPostings::NO_LIST) {
+        partition.term_lists[term_id] = static_cast<uint32_t>(partition.lists.size());
+        partition.lists.emplace_back();
+    }
+    return partition.lists[partition.term_lists[term_id]];
+}
+
+uint32_t SearchServer::GetDocumentSlot(int document_id) const {
+    const auto iter = documents_.find(document_id);
+    if (iter == documents_.end()) {
+        throw std::out_of_range("Not valid document id"s);
+    }
+    return iter->second.slot;
+}
+
+SearchServer::TermRange SearchServer::AppendTerms(const std::vector<std::pair<TermId, uint32_t>>& term_counts) {
+    auto& forward_terms = forward_terms_.Mutable();
+    auto& forward_counts = forward_counts_.Mutable();
+    const TermRange range = { forward_terms.size(), forward_terms.size() + term_counts.size() };
+    for (const auto& [term_id, count] : term_counts) {
+        forward_terms.push_back(term_id);
+        forward_counts.push_back(count);
+    }
+    return range;
+}
+
+SearchServer::MatchResult SearchServer::MatchSlot(const Query& query, uint32_t slot) const {
+    const DocumentStatus status = slot_statuses_[slot];
+    // Both the query words and the document terms are sorted, so one merge pass finds the common ones
+    const TermId* first_term = GetFirstTerm(slot);
+    const TermId* last_term = GetLastTerm(slot);
+    for (const TermId word : query.minus_words) {
+        first_term = std::lower_bound(first_term, last_term, word);
+        if (first_term != last_term && *first_term == word) {
+            return { std::vector<std::string_view>{}, status };
+        }
+    }
+    std::vector<std::string_view> matched_words;
+    first_term = GetFirstTerm(slot);
+    for (const TermId word : query.plus_words) {
+        first_term = std::lower_bound(first_term, last_term, word);
+        if (first_term == last_term) {
+            break;
+        }
+        if (*first_term == word) {
+            matched_words.push_back(lexicon_.GetTerm(word));
+        }
+    }
+    std::sort(matched_words.begin(), matched_words.end());
+
+    return { matched_words, status };
 }
@@ -14,80 +14,340 @@
 #include <deque>
 #include <type_traits>
 #include <future>
-#include "concurrent_map.h"
-
-constexpr double BORDER = 1e-6;
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <memory>
+#include <unordered_map>
+#include <array>
+#include <optional>
+#include "posting_list.h"
+#include "lexicon.h"
+#include "top_documents.h"
+#include "score_accumulator.h"
+#include "mapped_file.h"
+#include "snapshot.h"
+#include "fingerprint.h"
 
 constexpr int MAX_RESULT_DOCUMENT_COUNT = 5;
 
-constexpr size_t BUCKETS_N = 8;
+// Passed to FindTopDocuments in place of an execution policy to select
+// document-at-a-time retrieval with Block-Max WAND pruning
+struct DynamicPruningPolicy {};
+inline constexpr DynamicPruningPolicy dynamic_pruning;
+
+// Document of a batch passed to SearchServer::AddDocuments
+struct NewDocument {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// Position in the ranking after the last document of a result page. The next
+// page holds the documents ranked strictly below it, so pages never overlap.
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int id = 0;
+};
+
+// Page of search results, iterable like the vector of its documents
+struct SearchPage {
+    std::vector<Document> documents;
+    // Empty if no documents follow the page
+    std::optional<SearchCursor> next;
+
+    auto begin() const {
+        return documents.begin();
+    }
+
+    auto end() const {
+        return documents.end();
+    }
+
+    size_t size() const {
+        return documents.size();
+    }
+};
+
+// Removed documents leave dead postings that queries skip until a compaction
+// purges them; it runs once both thresholds are reached
+struct CompactionOptions {
+    // Compact on removal, otherwise only when Compact is called
+    bool automatic = true;
+    size_t min_dead_documents = 1024;
+    // Share of dead documents among all documents in the postings
+    double min_dead_fraction = 0.25;
+};
+
+// What adding a document with the same set of words as an existing one does
+enum class DuplicatePolicy {
+    ALLOW,
+    // AddDocument and AddDocuments throw std::invalid_argument
+    REJECT,
+    // The document is added, FindDuplicate reports the existing one
+    FLAG,
+};
+
+struct SearchServerOptions {
+    // Documents, queries and stop words are split and folded with the same options
+    TokenizerOptions tokenizer;
+    // Without the original texts memory per document depends only on its distinct words
+    bool retain_document_text = true;
+    CompactionOptions compaction;
+    // Except for ALLOW, word set fingerprints of all documents are indexed
+    DuplicatePolicy duplicates = DuplicatePolicy::ALLOW;
+};
 
 class SearchServer {
 public:
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string_view stop_words_text);
-    explicit SearchServer(const std::string& stop_words_text);
+    explicit SearchServer(const StringContainer& stop_words, SearchServerOptions options = {});
+    explicit SearchServer(const std::string_view stop_words_text, SearchServerOptions options = {});
+    explicit SearchServer(const std::string& stop_words_text, SearchServerOptions options = {});
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Checks the documents like AddDocument and adds either all of them or none.
+    // The parallel version tokenizes parts of the batch into separate partial
+    // indexes and merges them, the resulting index is the same.
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+
+    class PreparedDocuments;
+
+    // Tokenizes documents without changing the index. Only the stop words and
+    // options are read, so it may run concurrently with any other method.
+    PreparedDocuments PrepareDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents) const;
+    PreparedDocuments PrepareDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents) const;
+
+    // Adds prepared documents with the checks of AddDocuments
+    void AddDocuments(const std::execution::sequenced_policy&, PreparedDocuments&& documents);
+    void AddDocuments(const std::execution::parallel_policy&, PreparedDocuments&& documents);
+
+    // max_result_count limits the number of returned documents, the best ones come first
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view,
-        DocumentPredicate) const;
+        DocumentPredicate,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <class ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&&,
         std::string_view,
-        DocumentPredicate) const;
+        DocumentPredicate,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    std::vector<Document> FindTopDocuments(std::string_view, DocumentStatus) const;
+    std::vector<Document> FindTopDocuments(std::string_view, DocumentStatus,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <class ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, std::string_view, DocumentStatus) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&&, std::string_view, DocumentStatus,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document> FindTopDocuments(std::string_view) const;
 
+    // Buffers for parsing queries that hot loops can keep between searches
+    class QueryContext;
+
+    // Parse the query with the buffers of the context, which is used by one search at a time
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(QueryContext& context, std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(QueryContext& context, std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Query parsed once for several uses, e.g. for a cache key and the search on a cache miss
+    class ParsedQuery;
+
+    // Throws std::invalid_argument for the queries that FindTopDocuments rejects
+    ParsedQuery PrepareQuery(std::string_view raw_query) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ParsedQuery& query, DocumentPredicate document_predicate,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const ParsedQuery& query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Answers every query as FindTopDocuments does. Repeated queries, including the ones
+    // that are equal after parsing, are scored once; distinct queries are scored in parallel.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
     template <class ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&&, std::string_view) const;
 
+    // Search-after pagination: returns the page_size best documents ranked strictly below
+    // the cursor, or the first page without one. Only page_size + 1 documents are selected,
+    // so deep pages cost as much memory as the first one. Pages follow the current index,
+    // documents added or removed between calls shift the later pages.
+    template <typename DocumentPredicate>
+    SearchPage FindTopDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t page_size, const std::optional<SearchCursor>& after = std::nullopt) const;
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    SearchPage FindTopDocumentsPage(ExecutionPolicy&&, std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t page_size, const std::optional<SearchCursor>& after = std::nullopt) const;
+
+    SearchPage FindTopDocumentsPage(std::string_view raw_query, DocumentStatus status,
+        size_t page_size, const std::optional<SearchCursor>& after = std::nullopt) const;
+    template <class ExecutionPolicy>
+    SearchPage FindTopDocumentsPage(ExecutionPolicy&&, std::string_view raw_query, DocumentStatus status,
+        size_t page_size, const std::optional<SearchCursor>& after = std::nullopt) const;
+
     int GetDocumentCount() const;
 
-    auto begin() {
+    // IDF of the word among the current documents, 0 if none of them contains it
+    double GetInverseDocumentFreq(std::string_view word) const;
+
+    // Grows whenever documents are added or removed, search results stay the same within an epoch
+    uint64_t GetEpoch() const;
+
+    // Canonical form of the parsed query. Queries that differ only in the order of words,
+    // repeated words, stop words and words absent from the index get equal keys.
+    std::string GetQueryKey(std::string_view raw_query) const;
+    std::string GetQueryKey(const ParsedQuery& query) const;
+
+    // Returns an empty view if the server does not retain document texts
+    std::string_view GetDocumentText(int document_id) const;
+
+    auto begin() const {
         return document_index_.begin();
     }
 
-    auto end() {
+    auto end() const {
         return document_index_.end();
     }
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    WordSetFingerprint GetWordSetFingerprint(int document_id) const;
+    bool HaveSameWords(int lhs_document_id, int rhs_document_id) const;
+    // Jaccard similarity of the word sets, documents without words are equal
+    double GetWordSetSimilarity(int lhs_document_id, int rhs_document_id) const;
+    // Ids of the document's distinct words in ascending order
+    std::vector<TermId> GetDocumentTerms(int document_id) const;
+
+    // Smallest id of another document with the same set of words. Always empty with
+    // DuplicatePolicy::ALLOW, which keeps no fingerprint index.
+    std::optional<int> FindDuplicate(int document_id) const;
 
     using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
     MatchResult MatchDocument(const std::string_view raw_query, int document_id) const;
     MatchResult MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const;
     MatchResult MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const;
+    MatchResult MatchDocument(QueryContext& context, const std::string_view raw_query, int document_id) const;
+
+    // Matches the query, parsed once, against every document, e.g. the hits of a result page
+    std::vector<MatchResult> MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const;
+    std::vector<MatchResult> MatchDocuments(const std::execution::sequenced_policy&, const std::string_view raw_query,
+        const std::vector<int>& document_ids) const;
+    std::vector<MatchResult> MatchDocuments(const std::execution::parallel_policy&, const std::string_view raw_query,
+        const std::vector<int>& document_ids) const;
+
+    // Moves the document to the postings of the new status, its old postings are left for compaction
+    void SetDocumentStatus(int document_id, DocumentStatus status);
 
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy& exec, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+
+    // Whether dead postings of removed documents reached the compaction thresholds
+    bool NeedsCompaction() const;
+
+    // Purges the postings of removed documents and renumbers the slots of the remaining ones
+    void Compact();
+    void Compact(const std::execution::sequenced_policy&);
+    void Compact(const std::execution::parallel_policy&);
+
+    // Writes the index, documents, stop words and options to a binary snapshot file
+    void SaveSnapshot(const std::string& path) const;
+
+    // Maps a snapshot file without re-tokenizing documents. Postings, terms and document
+    // texts are read from the mapped file directly, the file stays mapped while the server lives.
+    // Without checksum verification the file is trusted and is not read in full on opening.
+    // Throws std::runtime_error if the file is missing, damaged or of another version.
+    static SearchServer OpenSnapshot(const std::string& path, bool verify_checksum = true);
 private:
     struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string document_content;
+        // Views the mapped file for documents opened from a snapshot
+        MappableVector<char> document_content;
+        uint32_t slot;
+
+        std::string_view GetContent() const {
+            return { document_content.data(), document_content.size() };
+        }
     };
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> id_to_word_freqs;
+    const SearchServerOptions options_;
+    Lexicon lexicon_;
+
+    static constexpr size_t STATUS_COUNT = 4;
+
+    // Postings of the documents with one status. A term gets a list in the partition
+    // once a document with the status contains it, most terms occur with few statuses.
+    struct StatusPostings {
+        static constexpr uint32_t NO_LIST = std::numeric_limits<uint32_t>::max();
+        // List index of every term, shorter than the lexicon if the last terms have no list
+        std::vector<uint32_t> term_lists;
+        std::vector<PostingList> lists;
+    };
+
+    // Both indexes are keyed by the term ids of lexicon_
+    std::array<StatusPostings, STATUS_COUNT> status_postings_;
+    // Forward index: the distinct terms of a slot in ascending order and their counts are
+    // a range of the arrays below. Ranges of dead slots are dropped by compaction.
+    struct TermRange {
+        uint64_t first = 0;
+        uint64_t last = 0;
+    };
+    std::vector<TermRange> slot_terms_;
+    MappableVector<TermId> forward_terms_;
+    MappableVector<uint32_t> forward_counts_;
     std::map<int, DocumentData> documents_;
     std::set<int> document_index_;
-    std::deque<std::string> storage;
+    // Postings refer to documents by dense slots handed out in insertion order. The
+    // columns below are indexed by slot, so searches read them without map lookups.
+    std::vector<int> slot_to_document_id_;
+    std::vector<int> slot_ratings_;
+    std::vector<DocumentStatus> slot_statuses_;
+    // Term frequency of a posting is its count multiplied by this
+    std::vector<double> slot_inv_word_counts_;
+    // Slots of removed documents whose postings are not purged yet
+    std::vector<bool> dead_slots_;
+    size_t dead_slot_count_ = 0;
+    // Live documents containing a term, postings also hold the dead ones. Logarithms
+    // of the counts are kept with them: IDF is log_document_count_ minus the term's one.
+    struct TermStats {
+        uint32_t document_count = 0;
+        double log_document_count = 0.0;
+    };
+    std::vector<TermStats> term_stats_;
+    double log_document_count_ = 0.0;
+    uint64_t epoch_ = 0;
+    // Documents by the fingerprints of their word sets, unless duplicates are allowed
+    std::unordered_map<WordSetFingerprint, std::vector<int>, WordSetFingerprintHash> fingerprint_documents_;
+    // Mapped snapshot that the lexicon and posting lists may view
+    std::shared_ptr<const MappedFile> snapshot_;
+
+    struct SnapshotDocument {
+        int32_t id;
+        int32_t rating;
+        int32_t status;
+        uint32_t slot;
+        uint64_t word_count;
+    };
 
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    static std::set<std::string, std::less<>> FoldStopWords(std::set<std::string, std::less<>> stop_words,
+        TokenizerOptions tokenizer_options);
+
+    // Words point into text or, when case is folded, into folded_text.
+    // Returns false if text has control characters.
+    template <typename Words>
+    bool TokenizeText(const std::string_view text, std::string& folded_text, Words& words) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
@@ -99,33 +359,202 @@ private:
 
     QueryWord ParseQueryWord(const std::string_view text) const;
 
+    // Words missing from the lexicon match no document and are dropped.
+    // Terms of a typical query are kept without allocation.
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        SmallVector<TermId, 8> plus_words;
+        SmallVector<TermId, 8> minus_words;
     };
 
     Query ParseQuery(const std::string_view text, bool sequenced = true) const;
+    Query ParseQuery(const std::string_view text, QueryContext& context, bool sequenced = true) const;
+
+    // Expects a query parsed in sequenced mode, whose words are sorted and unique
+    static std::string MakeQueryKey(const Query& query);
+
+    PreparedDocuments PrepareDocumentBatch(const std::vector<NewDocument>& documents, bool sequenced) const;
+    void AddPreparedBatch(PreparedDocuments&& prepared, bool sequenced);
+
+    void RemoveDocument(int document_id, bool sequenced);
+    void CompactSlots(bool sequenced);
+
+    void SetTermDocumentCount(TermId term_id, uint32_t document_count);
+    void UpdateLogDocumentCount();
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    static WordSetFingerprint ComputeWordSetFingerprint(const TermId* first_term, const TermId* last_term);
+    // Smallest id of an indexed document other than excluded_id that has exactly these terms
+    std::optional<int> FindDocumentWithWords(const WordSetFingerprint& fingerprint,
+        const TermId* first_term, const TermId* last_term, int excluded_id) const;
+
+    // Throws std::out_of_range for absent documents
+    uint32_t GetDocumentSlot(int document_id) const;
+
+    const TermId* GetFirstTerm(uint32_t slot) const {
+        return forward_terms_.data() + slot_terms_[slot].first;
+    }
+
+    const TermId* GetLastTerm(uint32_t slot) const {
+        return forward_terms_.data() + slot_terms_[slot].last;
+    }
+
+    // Appends the terms with their counts to the forward index and returns their range
+    TermRange AppendTerms(const std::vector<std::pair<TermId, uint32_t>>& term_counts);
+
+    bool DocumentHasTerm(uint32_t slot, TermId term_id) const {
+        return std::binary_search(GetFirstTerm(slot), GetLastTerm(slot), term_id);
+    }
+
+    // The query words must be sorted and unique
+    MatchResult MatchSlot(const Query& query, uint32_t slot) const;
+    std::vector<MatchResult> MatchDocumentBatch(const std::string_view raw_query, const std::vector<int>& document_ids,
+        bool sequenced) const;
+
+    double ComputeWordInverseDocumentFreq(TermId term_id) const {
+        return log_document_count_ - term_stats_[term_id].log_document_count;
+    }
+
+    const PostingList* FindPostings(DocumentStatus status, TermId term_id) const {
+        const StatusPostings& partition = status_postings_[static_cast<size_t>(status)];
+        if (term_id >= partition.term_lists.size() || partition.term_lists[term_id] == StatusPostings::NO_LIST) {
+            return nullptr;
+        }
+        return &partition.lists[partition.term_lists[term_id]];
+    }
+
+    // Creates the list if it is missing. Getting existing lists does not modify
+    // the partition, so tasks may do it concurrently.
+    PostingList& GetPostings(DocumentStatus status, TermId term_id);
+
+    // Searches by status go only through the postings of that status and look up no documents
+    struct StatusFilter {
+        DocumentStatus status;
+    };
+
+    template <typename DocumentPredicate, typename Function>
+    static void ForEachSearchedStatus(const DocumentPredicate& document_predicate, Function function) {
+        if constexpr (std::is_same_v<DocumentPredicate, StatusFilter>) {
+            function(document_predicate.status);
+        }
+        else {
+            for (size_t status = 0; status < STATUS_COUNT; ++status) {
+                function(static_cast<DocumentStatus>(status));
+            }
+        }
+    }
 
+    template <typename DocumentPredicate>
+    bool AcceptsDocument(DocumentPredicate& document_predicate, uint32_t slot) const {
+        if constexpr (std::is_same_v<DocumentPredicate, StatusFilter>) {
+            return true;
+        }
+        else {
+            return document_predicate(slot_to_document_id_[slot], slot_statuses_[slot], slot_ratings_[slot]);
+        }
+    }
+
+    // Throws std::invalid_argument for an empty page, which would not move the cursor
+    static void CheckPageSize(size_t page_size);
+    // Expects the page_size + 1 best documents, the last one only tells that more follow
+    static SearchPage MakeSearchPage(std::vector<Document> documents, size_t page_size);
+
+    template <class ExecutionPolicy, typename DocumentPredicate>
+    SearchPage FindDocumentPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t page_size, const std::optional<SearchCursor>& after) const;
+
+    // Scores the documents with slots in [first_slot, last_slot) and keeps the best of them
+    // ranked below after, if it is given
+    template <typename DocumentPredicate>
+    TopDocuments ScoreSlotRange(const Query& query, DocumentPredicate document_predicate,
+        uint32_t first_slot, uint32_t last_slot, size_t max_result_count, const Document* after = nullptr) const;
+
+    // Scores every matching document and keeps the best max_result_count of them
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const Query&,
-        DocumentPredicate) const;
+        DocumentPredicate,
+        size_t max_result_count) const;
 
+    // The overloads below skip documents not ranked below after, if it is given
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(std::execution::sequenced_policy,
         const Query&,
-        DocumentPredicate) const;
+        DocumentPredicate,
+        size_t max_result_count,
+        const Document* after = nullptr) const;
 
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(std::execution::parallel_policy,
         const Query&,
-        DocumentPredicate) const;
+        DocumentPredicate,
+        size_t max_result_count,
+        const Document* after = nullptr) const;
+
+    // Skips documents whose score upper bound cannot reach the current top,
+    // returns the same documents as the exhaustive search
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(DynamicPruningPolicy,
+        const Query&,
+        DocumentPredicate,
+        size_t max_result_count,
+        const Document* after = nullptr) const;
+};
+
+// Query parsing needs no allocation while the words of a query fit into the
+// buffers; a context grown by a long query keeps its capacity for the next ones
+class SearchServer::QueryContext {
+private:
+    friend class SearchServer;
+
+    std::string folded_text;
+    WordBuffer words;
+};
+
+// Refers to the terms of the server that parsed it. Words absent from the index are
+// dropped, so the query is only valid until documents are added.
+class SearchServer::ParsedQuery {
+private:
+    friend class SearchServer;
+
+    Query query;
+};
+
+// Batch of tokenized documents that are not in the index yet. Its words point
+// into the texts of the documents, which must outlive it.
+class SearchServer::PreparedDocuments {
+private:
+    friend class SearchServer;
+
+    // Contiguous part of the batch indexed by its own term ids, which are
+    // given lexicon ids when the batch is added
+    struct Part {
+        size_t first_document = 0;
+        size_t last_document = 0;
+        std::unordered_map<std::string_view, uint32_t> term_to_local_id;
+        std::vector<std::string_view> terms;
+        // Postings of every local term: batch index of the document and the word count
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> postings;
+        // Buffers that the terms point into when case is folded
+        std::deque<std::string> folded_texts;
+        // Bit of every status that the documents containing the term have
+        std::vector<uint8_t> term_statuses;
+        // Batch index of the document that stopped the part, if any had special characters
+        std::optional<size_t> first_invalid_document;
+    };
+
+    std::vector<Part> parts;
+    std::vector<uint32_t> document_parts;
+    std::vector<int> document_ids;
+    std::vector<int> ratings;
+    std::vector<DocumentStatus> statuses;
+    std::vector<DocumentData> document_data;
+    // Local term ids and counts of every document
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> document_terms;
+    std::vector<double> inv_word_counts;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+SearchServer::SearchServer(const StringContainer& stop_words, SearchServerOptions options)
+    : stop_words_(FoldStopWords(MakeUniqueNonEmptyStrings(stop_words), options.tokenizer))  // Extract non-empty stop words
+    , options_(options)
 {
     using namespace std::string_literals;
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
@@ -135,43 +564,45 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
-    DocumentPredicate document_predicate) const
+    DocumentPredicate document_predicate, size_t max_result_count) const
 {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_result_count);
 }
 
 template <class ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy,
     const std::string_view raw_query,
-    DocumentPredicate document_predicate) const
+    DocumentPredicate document_predicate,
+    size_t max_result_count) const
 {
     const auto query = ParseQuery(raw_query);
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    return FindAllDocuments(policy, query, document_predicate, max_result_count);
+}
 
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < BORDER) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t max_result_count) const
+{
+    const auto query = ParseQuery(raw_query, context);
 
-    return matched_documents;
+    return FindAllDocuments(std::execution::seq, query, document_predicate, max_result_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ParsedQuery& query, DocumentPredicate document_predicate,
+    size_t max_result_count) const
+{
+    return FindAllDocuments(std::execution::seq, query.query, document_predicate, max_result_count);
 }
 
 template <class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+    size_t max_result_count) const
 {
-    return FindTopDocuments(policy, raw_query,
-        [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    const auto query = ParseQuery(raw_query);
+
+    return FindAllDocuments(policy, query, StatusFilter{ status }, max_result_count);
 }
 
 template <class ExecutionPolicy>
@@ -180,93 +611,227 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, s
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
+template <typename DocumentPredicate>
+SearchPage SearchServer::FindTopDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate,
+    size_t page_size, const std::optional<SearchCursor>& after) const
+{
+    return FindDocumentPage(std::execution::seq, raw_query, document_predicate, page_size, after);
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+SearchPage SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t page_size, const std::optional<SearchCursor>& after) const
+{
+    return FindDocumentPage(policy, raw_query, document_predicate, page_size, after);
+}
+
+template <class ExecutionPolicy>
+SearchPage SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+    size_t page_size, const std::optional<SearchCursor>& after) const
+{
+    return FindDocumentPage(policy, raw_query, StatusFilter{ status }, page_size, after);
+}
+
+template <class ExecutionPolicy, typename DocumentPredicate>
+SearchPage SearchServer::FindDocumentPage(ExecutionPolicy&& policy, std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t page_size, const std::optional<SearchCursor>& after) const
+{
+    CheckPageSize(page_size);
+    const auto query = ParseQuery(raw_query);
+    if (!after) {
+        return MakeSearchPage(FindAllDocuments(policy, query, document_predicate, page_size + 1), page_size);
+    }
+    const Document last_document(after->id, after->relevance, after->rating);
+    return MakeSearchPage(FindAllDocuments(policy, query, document_predicate, page_size + 1, &last_document), page_size);
+}
+
 template<typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const
+inline std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate,
+    size_t max_result_count) const
 {
-    return SearchServer::FindAllDocuments(std::execution::seq, query, document_predicate);
+    return SearchServer::FindAllDocuments(std::execution::seq, query, document_predicate, max_result_count);
 }
 
 template<typename DocumentPredicate>
 inline std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy,
-    const Query& query, DocumentPredicate document_predicate) const
+    const Query& query, DocumentPredicate document_predicate, size_t max_result_count, const Document* after) const
 {
-    std::map<int, double> document_to_relevance;
+    return ScoreSlotRange(query, document_predicate, 0, static_cast<uint32_t>(slot_to_document_id_.size()), max_result_count,
+        after).Extract();
+}
 
-    std::vector<Document> matched_documents;
+// Every task owns a disjoint range of slots, so the accumulators need no locking
+// and only the small per-range selections are merged
+template<typename DocumentPredicate>
+inline std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy,
+    const Query& query, DocumentPredicate document_predicate, size_t max_result_count, const Document* after) const
+{
+    const uint32_t slot_count = static_cast<uint32_t>(slot_to_document_id_.size());
+    const uint32_t range_count = std::max(1u, std::min(std::thread::hardware_concurrency() * 4, slot_count));
+    std::vector<TopDocuments> partial(range_count, TopDocuments(max_result_count));
+
+    std::vector<uint32_t> range_indexes(range_count);
+    std::iota(range_indexes.begin(), range_indexes.end(), 0);
+    std::for_each(policy, range_indexes.begin(), range_indexes.end(), [&](uint32_t range_index) {
+        const uint32_t first_slot = static_cast<uint64_t>(slot_count) * range_index / range_count;
+        const uint32_t last_slot = static_cast<uint64_t>(slot_count) * (range_index + 1) / range_count;
+        partial[range_index] = ScoreSlotRange(query, document_predicate, first_slot, last_slot, max_result_count, after);
+        });
 
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
-        }
+    TopDocuments top_documents(max_result_count);
+    for (const TopDocuments& range_top : partial) {
+        top_documents.Merge(range_top);
     }
+    return top_documents.Extract();
+}
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename DocumentPredicate>
+TopDocuments SearchServer::ScoreSlotRange(const Query& query, DocumentPredicate document_predicate,
+    uint32_t first_slot, uint32_t last_slot, size_t max_result_count, const Document* after) const
+{
+    ScoreAccumulator::Lease document_to_relevance;
+    document_to_relevance->Reset(first_slot, last_slot - first_slot);
+
+    // A document is in the postings of one status only, so its score is summed in query order
+    ForEachSearchedStatus(document_predicate, [&](DocumentStatus status) {
+        for (const TermId word : query.plus_words) {
+            const PostingList* postings = FindPostings(status, word);
+            if (postings == nullptr || term_stats_[word].document_count == 0) {
+                continue;
+            }
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+            postings->ForEachInRange(first_slot, last_slot, [&](uint32_t slot, uint32_t count) {
+                if (!dead_slots_[slot] && AcceptsDocument(document_predicate, slot)) {
+                    const double term_freq = count * slot_inv_word_counts_[slot];
+                    document_to_relevance->Add(slot, term_freq * inverse_document_freq);
+                }
+                });
         }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+
+        for (const TermId word : query.minus_words) {
+            if (const PostingList* postings = FindPostings(status, word)) {
+                postings->ForEachInRange(first_slot, last_slot, [&](uint32_t slot, uint32_t) {
+                    document_to_relevance->Exclude(slot);
+                    });
+            }
         }
-    }
+        });
 
-    for (const auto& [document_id, relevance] : document_to_relevance) {
-        matched_documents.emplace_back(
-            Document(document_id, relevance, documents_.at(document_id).rating)
-        );
-    }
-    return matched_documents;
+    TopDocuments top_documents(max_result_count, after);
+    document_to_relevance->ForEachScored([&](uint32_t slot, double relevance) {
+        top_documents.Add(Document(slot_to_document_id_[slot], relevance, slot_ratings_[slot]));
+        });
+    return top_documents;
 }
 
 template<typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy,
-    const Query& query, DocumentPredicate document_predicate) const
+inline std::vector<Document> SearchServer::FindAllDocuments(DynamicPruningPolicy,
+    const Query& query, DocumentPredicate document_predicate, size_t max_result_count, const Document* after) const
 {
-    ConcurrentMap<int, double> document_to_relevance(BUCKETS_N);
-
-    std::vector<Document> matched_documents;
-    for_each(policy, query.plus_words.begin(), query.plus_words.end(),
-        [&](std::string_view word)
-        {
-            if (!word_to_document_freqs_.count(word) == 0)
-            {
+    struct TermCursor {
+        PostingList::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+    };
+
+    if (max_result_count == 0) {
+        return {};
+    }
+
+    // The statuses are searched one after another, so the top found in one prunes the next.
+    // Documents above the cursor are dropped on adding, the top holds only ones below it.
+    TopDocuments top_documents(max_result_count, after);
+    ForEachSearchedStatus(document_predicate, [&](DocumentStatus status) {
+        // Kept in query order so that scores are summed exactly as in the exhaustive search
+        std::vector<TermCursor> terms;
+        for (const TermId word : query.plus_words) {
+            const PostingList* postings = FindPostings(status, word);
+            if (postings != nullptr && term_stats_[word].document_count != 0) {
                 const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word))
-                {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating))
-                    {
-                        document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                    }
-                }
+                terms.push_back({ PostingList::Cursor(*postings), inverse_document_freq, postings->GetMaxTermFreq() * inverse_document_freq });
             }
         }
-    );
-
-    for_each(policy, query.minus_words.begin(), query.minus_words.end(),
-        [&](std::string_view word)
-        {
-            if (!word_to_document_freqs_.count(word) == 0)
-            {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word))
-                {
-                    document_to_relevance.Erase(document_id);
-                }
+        std::vector<PostingList::Cursor> minus_cursors;
+        for (const TermId word : query.minus_words) {
+            if (const PostingList* postings = FindPostings(status, word)) {
+                minus_cursors.emplace_back(*postings);
             }
         }
-    );
 
-    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap())
-    {
-        matched_documents.emplace_back(
-            Document(document_id, relevance, documents_.at(document_id).rating)
-        );
-    }
-    return matched_documents;
+        std::vector<TermCursor*> order(terms.size());
+        std::transform(terms.begin(), terms.end(), order.begin(), [](TermCursor& term) { return &term; });
+
+        while (true) {
+            std::sort(order.begin(), order.end(), [](const TermCursor* lhs, const TermCursor* rhs) {
+                return lhs->cursor.GetSlot() < rhs->cursor.GetSlot();
+                });
+
+            // A document ranking below the worst one by BORDER or more cannot enter the top
+            const double min_score = top_documents.IsFull()
+                ? top_documents.GetWorst().relevance - BORDER
+                : -std::numeric_limits<double>::infinity();
+
+            // The pivot is the first document whose accumulated upper bound reaches min_score
+            size_t pivot = 0;
+            double upper_bound = 0.0;
+            for (; pivot < order.size() && order[pivot]->cursor.GetSlot() != PostingList::Cursor::END; ++pivot) {
+                upper_bound += order[pivot]->max_score;
+                if (upper_bound >= min_score) {
+                    break;
+                }
+            }
+            if (pivot == order.size() || order[pivot]->cursor.GetSlot() == PostingList::Cursor::END) {
+                break;
+            }
+            const int64_t pivot_id = order[pivot]->cursor.GetSlot();
+            while (pivot + 1 < order.size() && order[pivot + 1]->cursor.GetSlot() == pivot_id) {
+                ++pivot;
+            }
+
+            // Block-max check: the blocks around pivot_id may bound the score more tightly
+            double block_upper_bound = 0.0;
+            int64_t next_candidate = pivot + 1 < order.size() ? order[pivot + 1]->cursor.GetSlot() : PostingList::Cursor::END;
+            for (size_t i = 0; i <= pivot; ++i) {
+                const auto block_bound = order[i]->cursor.GetBlockBound(pivot_id);
+                block_upper_bound += block_bound.max_term_freq * order[i]->inverse_document_freq;
+                if (block_bound.last_slot != PostingList::Cursor::END) {
+                    next_candidate = std::min(next_candidate, block_bound.last_slot + 1);
+                }
+            }
+            if (block_upper_bound < min_score) {
+                for (size_t i = 0; i <= pivot; ++i) {
+                    order[i]->cursor.SkipTo(next_candidate);
+                }
+                continue;
+            }
+
+            if (order[0]->cursor.GetSlot() != pivot_id) {
+                for (size_t i = 0; i < pivot && order[i]->cursor.GetSlot() < pivot_id; ++i) {
+                    order[i]->cursor.SkipTo(pivot_id);
+                }
+                continue;
+            }
+
+            const int document_id = slot_to_document_id_[pivot_id];
+            const bool has_minus_word = std::any_of(minus_cursors.begin(), minus_cursors.end(),
+                [pivot_id](PostingList::Cursor& cursor) {
+                    cursor.SkipTo(pivot_id);
+                    return cursor.GetSlot() == pivot_id;
+                });
+            if (!dead_slots_[pivot_id] && !has_minus_word && AcceptsDocument(document_predicate, pivot_id)) {
+                double relevance = 0.0;
+                for (const TermCursor& term : terms) {
+                    if (term.cursor.GetSlot() == pivot_id) {
+                        const double term_freq = term.cursor.GetCount() * slot_inv_word_counts_[pivot_id];
+                        relevance += term_freq * term.inverse_document_freq;
+                    }
+                }
+                top_documents.Add(Document(document_id, relevance, slot_ratings_[pivot_id]));
+            }
+            for (size_t i = 0; i <= pivot; ++i) {
+                order[i]->cursor.SkipTo(pivot_id + 1);
+            }
+        }
+        });
+    return top_documents.Extract();
 }
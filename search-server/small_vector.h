@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// Vector of trivially copyable elements that keeps up to InlineCapacity of them
+// in the object itself and allocates only when it grows beyond that. Cleared
+// vectors keep their capacity, so a reused one stops allocating.
+template <typename T, size_t InlineCapacity>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVector copies elements as bytes");
+    static_assert(InlineCapacity > 0, "SmallVector doubles its capacity to grow");
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() = default;
+
+    SmallVector(const SmallVector& other) {
+        Append(other.begin(), other.end());
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            clear();
+            Append(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    SmallVector(SmallVector&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            heap_.reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    void push_back(const T& value) {
+        if (size_ == capacity_) {
+            Grow(capacity_ * 2);
+        }
+        data()[size_++] = value;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+
+    // Drops the elements in [first, end())
+    void erase(iterator first, iterator last) {
+        std::copy(last, end(), first);
+        size_ -= last - first;
+    }
+
+    void reserve(size_t capacity) {
+        if (capacity > capacity_) {
+            Grow(capacity);
+        }
+    }
+
+    T* data() {
+        return heap_ ? heap_.get() : inline_;
+    }
+
+    const T* data() const {
+        return heap_ ? heap_.get() : inline_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    T& operator[](size_t index) {
+        return data()[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    iterator begin() {
+        return data();
+    }
+
+    iterator end() {
+        return data() + size_;
+    }
+
+    const_iterator begin() const {
+        return data();
+    }
+
+    const_iterator end() const {
+        return data() + size_;
+    }
+
+private:
+    T inline_[InlineCapacity];
+    std::unique_ptr<T[]> heap_;
+    size_t size_ = 0;
+    size_t capacity_ = InlineCapacity;
+
+    void Grow(size_t capacity) {
+        std::unique_ptr<T[]> heap(new T[capacity]);
+        std::memcpy(heap.get(), data(), size_ * sizeof(T));
+        heap_ = std::move(heap);
+        capacity_ = capacity;
+    }
+
+    void Append(const T* first, const T* last) {
+        reserve(size_ + (last - first));
+        std::memcpy(data() + size_, first, (last - first) * sizeof(T));
+        size_ += last - first;
+    }
+
+    void MoveFrom(SmallVector& other) {
+        if (other.heap_) {
+            heap_ = std::move(other.heap_);
+            capacity_ = other.capacity_;
+        }
+        else {
+            std::memcpy(inline_, other.inline_, other.size_ * sizeof(T));
+            capacity_ = InlineCapacity;
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+        other.capacity_ = InlineCapacity;
+    }
+};
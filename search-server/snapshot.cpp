@@ -0,0 +1,153 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+using namespace std::string_literals;
+
+namespace {
+constexpr char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr size_t ALIGNMENT = 8;
+constexpr uint64_t CHECKSUM_SEED = 0x9E3779B97F4A7C15ull;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+size_t GetPaddedSize(size_t size) {
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// Hashes 8-byte words, a partial last word is completed with zero bytes like the padding in the file
+uint64_t UpdateChecksum(uint64_t checksum, const char* data, size_t size) {
+    for (size_t offset = 0; offset < size; offset += ALIGNMENT) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + offset, std::min(ALIGNMENT, size - offset));
+        checksum = ((checksum << 27 | checksum >> 37) ^ (word * 0x87C37B91114253D5ull)) * 0x4CF5AD432745937Full;
+    }
+    return checksum;
+}
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp"s)
+    , output_(temporary_path_, std::ios::binary | std::ios::trunc)
+    , checksum_(CHECKSUM_SEED) {
+    if (!output_) {
+        throw std::runtime_error("Cannot create snapshot "s + path);
+    }
+    // Zeroed header until Finish, so an incomplete snapshot fails the magic check
+    const SnapshotHeader header = {};
+    output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!finished_) {
+        output_.close();
+        std::remove(temporary_path_.c_str());
+    }
+}
+
+void SnapshotWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> offsets = { 0 };
+    std::string bytes;
+    for (const std::string_view str : strings) {
+        bytes += str;
+        offsets.push_back(bytes.size());
+    }
+    WriteArray(offsets);
+    WriteArray(bytes);
+}
+
+void SnapshotWriter::Finish() {
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.payload_size = payload_size_;
+    header.checksum = checksum_;
+    output_.seekp(0);
+    output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output_.close();
+    if (!output_) {
+        throw std::runtime_error("Cannot write snapshot "s + path_);
+    }
+    // Servers that mapped the previous file keep viewing it, the rename only replaces the name
+    std::error_code error;
+    std::filesystem::rename(temporary_path_, path_, error);
+    if (error) {
+        throw std::runtime_error("Cannot write snapshot "s + path_ + ": "s + error.message());
+    }
+    finished_ = true;
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    static const char padding[ALIGNMENT] = {};
+    if (size > 0) {
+        output_.write(static_cast<const char*>(data), size);
+        checksum_ = UpdateChecksum(checksum_, static_cast<const char*>(data), size);
+    }
+    output_.write(padding, GetPaddedSize(size) - size);
+    payload_size_ += GetPaddedSize(size);
+}
+
+SnapshotReader::SnapshotReader(const char* data, size_t size, bool verify_checksum) {
+    SnapshotHeader header;
+    if (size < sizeof(header)) {
+        ThrowCorrupted();
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("File is not a search server snapshot"s);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version "s + std::to_string(header.version));
+    }
+    if (header.byte_order != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Snapshot was written with another byte order"s);
+    }
+    if (header.payload_size != size - sizeof(header)) {
+        ThrowCorrupted();
+    }
+    position_ = data + sizeof(header);
+    end_ = data + size;
+    if (verify_checksum && UpdateChecksum(CHECKSUM_SEED, position_, end_ - position_) != header.checksum) {
+        ThrowCorrupted();
+    }
+}
+
+std::vector<std::string_view> SnapshotReader::ReadStrings() {
+    const MappableVector<uint64_t> offsets = ReadArray<uint64_t>();
+    const MappableVector<char> bytes = ReadArray<char>();
+    if (offsets.empty() || offsets[offsets.size() - 1] != bytes.size()) {
+        ThrowCorrupted();
+    }
+    std::vector<std::string_view> strings;
+    strings.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            ThrowCorrupted();
+        }
+        strings.emplace_back(bytes.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
+
+void SnapshotReader::ThrowCorrupted() {
+    throw std::runtime_error("Snapshot is corrupted"s);
+}
+
+const char* SnapshotReader::ReadBytes(size_t size) {
+    if (GetPaddedSize(size) > static_cast<size_t>(end_ - position_)) {
+        ThrowCorrupted();
+    }
+    const char* data = position_;
+    position_ += GetPaddedSize(size);
+    return data;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "mappable_vector.h"
+
+// A snapshot is a header with the format version, payload size and checksum
+// followed by the payload: values and arrays padded to 8 bytes. An array is its
+// element count followed by the raw elements, so a reader of a mapped snapshot
+// views them in place. Numbers keep the byte order of the writing machine.
+constexpr uint32_t SNAPSHOT_VERSION = 4;
+
+// Writes to a temporary file next to path, which replaces the file at path only
+// once the snapshot is finished, so a failed save keeps the previous snapshot
+class SnapshotWriter {
+public:
+    // Throws std::runtime_error if the file cannot be created
+    explicit SnapshotWriter(const std::string& path);
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+    // Removes the temporary file of an unfinished snapshot
+    ~SnapshotWriter();
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteBytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void WriteArray(const T* data, size_t size) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteValue<uint64_t>(size);
+        WriteBytes(data, size * sizeof(T));
+    }
+
+    template <typename Container>
+    void WriteArray(const Container& elements) {
+        WriteArray(elements.data(), elements.size());
+    }
+
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+    // Writes the header and moves the snapshot to path, a snapshot without the header
+    // is rejected by SnapshotReader
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream output_;
+    bool finished_ = false;
+    uint64_t payload_size_ = 0;
+    uint64_t checksum_;
+
+    void WriteBytes(const void* data, size_t size);
+};
+
+class SnapshotReader {
+public:
+    // Checks the header and, on request, the payload checksum. Throws std::runtime_error
+    SnapshotReader(const char* data, size_t size, bool verify_checksum);
+
+    template <typename T>
+    T ReadValue() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // The returned array views the snapshot data
+    template <typename T>
+    MappableVector<T> ReadArray() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint64_t size = ReadValue<uint64_t>();
+        if (size > static_cast<uint64_t>(end_ - position_) / sizeof(T)) {
+            ThrowCorrupted();
+        }
+        const char* data = ReadBytes(static_cast<size_t>(size) * sizeof(T));
+        return MappableVector<T>::View(reinterpret_cast<const T*>(data), static_cast<size_t>(size));
+    }
+
+    std::vector<std::string_view> ReadStrings();
+
+    bool AtEnd() const {
+        return position_ == end_;
+    }
+
+    [[noreturn]] static void ThrowCorrupted();
+
+private:
+    const char* position_;
+    const char* end_;
+
+    const char* ReadBytes(size_t size);
+};
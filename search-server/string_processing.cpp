@@ -2,16 +2,282 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <cstdint>
 
-std::vector<std::string_view> SplitIntoWords(std::string_view str) {
-    std::vector<std::string_view> result;
-    str.remove_prefix(std::min(str.find_first_not_of(" "), str.size()));
-    const int64_t pos_end = str.npos;
-    while (str.size()) {
-        int64_t space = str.find(' ');
-        result.push_back(str.substr(0, space));
-        space == pos_end ? str.remove_prefix(str.size()) : str.remove_prefix(space + 1);
-        str.remove_prefix(std::min(str.find_first_not_of(" "), str.size()));
+#if defined(__x86_64__) || defined(_M_X64)
+#define SEARCH_SERVER_X86_64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+// Text is classified by chunks of 64 bytes, one bit per byte
+constexpr size_t CHUNK_SIZE = 64;
+
+struct ByteMasks {
+    uint64_t spaces = 0;
+    uint64_t controls = 0;
+    uint64_t non_ascii = 0;
+};
+
+using Classifier = ByteMasks(*)(const char* chunk);
+
+#ifndef SEARCH_SERVER_X86_64
+ByteMasks ClassifyScalar(const char* chunk) {
+    ByteMasks masks;
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+        const uint8_t byte = static_cast<uint8_t>(chunk[i]);
+        masks.spaces |= static_cast<uint64_t>(byte == ' ') << i;
+        masks.controls |= static_cast<uint64_t>(byte < ' ') << i;
+        masks.non_ascii |= static_cast<uint64_t>(byte >= 0x80) << i;
     }
+    return masks;
+}
+#else
+ByteMasks ClassifySse2(const char* chunk) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i last_control = _mm_set1_epi8(' ' - 1);
+    ByteMasks masks;
+    for (size_t i = 0; i < CHUNK_SIZE; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + i));
+        // Unsigned byte <= 31 is the same as min(byte, 31) == byte
+        const __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(bytes, last_control), bytes);
+        masks.spaces |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)))) << i;
+        masks.controls |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(controls))) << i;
+        masks.non_ascii |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(bytes))) << i;
+    }
+    return masks;
+}
+
+TARGET_AVX2 ByteMasks ClassifyAvx2(const char* chunk) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+    ByteMasks masks;
+    for (size_t i = 0; i < CHUNK_SIZE; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunk + i));
+        const __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, last_control), bytes);
+        masks.spaces |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)))) << i;
+        masks.controls |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(controls))) << i;
+        masks.non_ascii |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(bytes))) << i;
+    }
+    return masks;
+}
+
+bool SupportsAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // The OS must save the upper halves of the ymm registers
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+Classifier GetClassifier() {
+#ifdef SEARCH_SERVER_X86_64
+    static const Classifier classifier = SupportsAvx2() ? ClassifyAvx2 : ClassifySse2;
+    return classifier;
+#else
+    return ClassifyScalar;
+#endif
+}
+
+size_t CountTrailingZeros(uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// Length of the Unicode space encoded at the start of bytes, 0 if there is none
+size_t GetUnicodeSpaceLength(std::string_view bytes) {
+    const auto byte = [bytes](size_t i) -> uint8_t {
+        return i < bytes.size() ? static_cast<uint8_t>(bytes[i]) : 0;
+    };
+    switch (byte(0)) {
+    case 0xC2: // U+0085, U+00A0
+        return byte(1) == 0x85 || byte(1) == 0xA0 ? 2 : 0;
+    case 0xE1: // U+1680
+        return byte(1) == 0x9A && byte(2) == 0x80 ? 3 : 0;
+    case 0xE2: // U+2000..U+200A, U+2028, U+2029, U+202F, U+205F
+        if (byte(1) == 0x80) {
+            const uint8_t last = byte(2);
+            return (last >= 0x80 && last <= 0x8A) || last == 0xA8 || last == 0xA9 || last == 0xAF ? 3 : 0;
+        }
+        return byte(1) == 0x81 && byte(2) == 0x9F ? 3 : 0;
+    case 0xE3: // U+3000
+        return byte(1) == 0x80 && byte(2) == 0x80 ? 3 : 0;
+    default:
+        return 0;
+    }
+}
+
+// Words is any container of string views with push_back
+template <typename Words>
+class WordScanner {
+public:
+    WordScanner(std::string_view text, Words& words, bool unicode_spaces, bool validate)
+        : text_(text)
+        , words_(words)
+        , unicode_spaces_(unicode_spaces)
+        , validate_(validate) {
+    }
+
+    // Returns false at the first control character if the text is validated
+    bool Scan() {
+        const Classifier classify = GetClassifier();
+        while (position_ + CHUNK_SIZE <= text_.size()) {
+            const ByteMasks masks = classify(text_.data() + position_);
+            if (validate_ && masks.controls != 0) {
+                return false;
+            }
+            if (unicode_spaces_ && masks.non_ascii != 0) {
+                // Multibyte spaces may cross the chunk end, the scan then resumes after them
+                ScanBytes(position_ + CHUNK_SIZE);
+            }
+            else {
+                ScanSpaces(masks.spaces);
+                position_ += CHUNK_SIZE;
+            }
+        }
+        if (!ScanBytes(text_.size())) {
+            return false;
+        }
+        EndWord(text_.size());
+        return true;
+    }
+
+private:
+    static constexpr size_t NO_WORD = std::string_view::npos;
+
+    std::string_view text_;
+    Words& words_;
+    bool unicode_spaces_;
+    bool validate_;
+    size_t position_ = 0;
+    size_t word_start_ = NO_WORD;
+
+    void StartWord(size_t position) {
+        if (word_start_ == NO_WORD) {
+            word_start_ = position;
+        }
+    }
+
+    void EndWord(size_t position) {
+        if (word_start_ != NO_WORD) {
+            words_.push_back(text_.substr(word_start_, position - word_start_));
+            word_start_ = NO_WORD;
+        }
+    }
+
+    // Words start and end where a space bit differs from the bit of the previous byte
+    void ScanSpaces(uint64_t spaces) {
+        const uint64_t previous_spaces = (spaces << 1) | (word_start_ == NO_WORD ? 1 : 0);
+        for (uint64_t boundaries = spaces ^ previous_spaces; boundaries != 0; boundaries &= boundaries - 1) {
+            const size_t position = position_ + CountTrailingZeros(boundaries);
+            if (word_start_ == NO_WORD) {
+                StartWord(position);
+            }
+            else {
+                EndWord(position);
+            }
+        }
+    }
+
+    bool ScanBytes(size_t end) {
+        while (position_ < end) {
+            const uint8_t byte = static_cast<uint8_t>(text_[position_]);
+            if (validate_ && byte < ' ') {
+                return false;
+            }
+            size_t space_length = byte == ' ' ? 1 : 0;
+            if (unicode_spaces_ && byte >= 0x80) {
+                space_length = GetUnicodeSpaceLength(text_.substr(position_));
+            }
+            if (space_length > 0) {
+                EndWord(position_);
+                position_ += space_length;
+            }
+            else {
+                StartWord(position_);
+                ++position_;
+            }
+        }
+        return true;
+    }
+};
+}
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text, bool unicode_spaces) {
+    std::vector<std::string_view> result;
+    WordScanner(text, result, unicode_spaces, false).Scan();
+    return result;
+}
+
+bool Tokenize(std::string_view text, std::vector<std::string_view>& words, bool unicode_spaces) {
+    return WordScanner(text, words, unicode_spaces, true).Scan();
+}
+
+bool Tokenize(std::string_view text, WordBuffer& words, bool unicode_spaces) {
+    return WordScanner(text, words, unicode_spaces, true).Scan();
+}
+
+std::string FoldCase(std::string_view text) {
+    std::string result;
+    FoldCase(text, result);
     return result;
 }
+
+void FoldCase(std::string_view text, std::string& result) {
+    result.assign(text);
+    for (size_t i = 0; i < result.size(); ++i) {
+        const uint8_t byte = static_cast<uint8_t>(result[i]);
+        if (byte < 0x80) {
+            if (static_cast<uint8_t>(byte - 'A') < 26) {
+                result[i] = static_cast<char>(byte + ('a' - 'A'));
+            }
+            continue;
+        }
+        if (i + 1 == result.size()) {
+            break;
+        }
+        const uint8_t next = static_cast<uint8_t>(result[i + 1]);
+        if (byte == 0xC3 && next >= 0x80 && next <= 0x9E && next != 0x97) {
+            // À..Þ without the multiplication sign
+            result[i + 1] = static_cast<char>(next + 0x20);
+        }
+        else if (byte == 0xD0 && next >= 0x90 && next <= 0x9F) {
+            // А..П
+            result[i + 1] = static_cast<char>(next + 0x20);
+        }
+        else if (byte == 0xD0 && next >= 0xA0 && next <= 0xAF) {
+            // Р..Я
+            result[i] = static_cast<char>(0xD1);
+            result[i + 1] = static_cast<char>(next - 0x20);
+        }
+        else if (byte == 0xD0 && next >= 0x80 && next <= 0x8F) {
+            // Ѐ..Џ
+            result[i] = static_cast<char>(0xD1);
+            result[i + 1] = static_cast<char>(next + 0x10);
+        }
+    }
+}
@@ -1,9 +1,31 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
+#include "small_vector.h"
 
-std::vector<std::string_view> SplitIntoWords(const std::string_view text);
+struct TokenizerOptions {
+    // Also splits on Unicode spaces encoded in UTF-8, such as the no-break space
+    bool unicode_spaces = false;
+    // Lowers capital ASCII, Latin-1 and Cyrillic letters before splitting
+    bool fold_case = false;
+};
+
+// Words of a typical query fit without allocation
+using WordBuffer = SmallVector<std::string_view, 16>;
+
+std::vector<std::string_view> SplitIntoWords(const std::string_view text, bool unicode_spaces = false);
+
+// Splits text like SplitIntoWords and checks in the same pass that it has no
+// control characters. Returns false at the first one, words are incomplete then.
+bool Tokenize(const std::string_view text, std::vector<std::string_view>& words, bool unicode_spaces = false);
+bool Tokenize(const std::string_view text, WordBuffer& words, bool unicode_spaces = false);
+
+// Folded letters keep their UTF-8 length, so word boundaries do not move
+std::string FoldCase(const std::string_view text);
+// Writes into result, whose capacity is reused
+void FoldCase(const std::string_view text, std::string& result);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
@@ -14,4 +36,4 @@ std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContain
         }
     }
     return non_empty_strings;
-}
\ No newline at end of file
+}
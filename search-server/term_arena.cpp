@@ -0,0 +1,23 @@
+#include "term_arena.h"
+#include <algorithm>
+
+std::string_view TermArena::Store(const std::string_view bytes) {
+    if (bytes.size() > CHUNK_SIZE / 4) {
+        // Long strings get their own chunk, the current one stays open for short ones
+        auto chunk = std::make_unique<char[]>(bytes.size());
+        std::copy(bytes.begin(), bytes.end(), chunk.get());
+        allocated_size_ += bytes.size();
+        const std::string_view stored(chunk.get(), bytes.size());
+        chunks_.insert(chunks_.empty() ? chunks_.end() : chunks_.end() - 1, std::move(chunk));
+        return stored;
+    }
+    if (CHUNK_SIZE - chunk_used_ < bytes.size()) {
+        chunks_.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+        chunk_used_ = 0;
+        allocated_size_ += CHUNK_SIZE;
+    }
+    char* destination = chunks_.back().get() + chunk_used_;
+    std::copy(bytes.begin(), bytes.end(), destination);
+    chunk_used_ += bytes.size();
+    return { destination, bytes.size() };
+}
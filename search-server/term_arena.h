@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for short strings. Bytes are packed back to back into
+// large chunks that never move, so the returned views stay valid as long as
+// the arena lives, moves of the arena included.
+class TermArena {
+public:
+    std::string_view Store(const std::string_view bytes);
+
+    // Bytes allocated for chunks, the unused ends of chunks included
+    size_t GetAllocatedSize() const {
+        return allocated_size_;
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    size_t chunk_used_ = CHUNK_SIZE;
+    size_t allocated_size_ = 0;
+};
@@ -3,9 +3,29 @@
 #include "document.h" 
 #include "request_queue.h" 
 #include "remove_duplicates.h" 
+#include "concurrent_map.h"
+#include "posting_list.h"
+#include "term_arena.h"
+#include "ingest_pipeline.h"
+#include "versioned_search_server.h"
+#include "query_cache.h"
+#include "process_queries.h"
+#include "near_duplicates.h"
+#include "paginator.h"
 #include <set> 
+#include <map>
+#include <random>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <new>
  
 using namespace std::string_literals; 
+using namespace std::string_view_literals;
  
 void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line, 
     const std::string& hint) { 
@@ -269,6 +289,1390 @@ void TestRemoveDuplicates() {
     ASSERT_EQUAL(documents[3].id, 8); 
     ASSERT_EQUAL(documents[4].id, 6); 
 } 
+void TestRemoveDocument() {
+    SearchServer server("and with"s);
+    // Документы добавляются не по порядку id, списки словопозиций должны остаться отсортированными
+    server.AddDocument(5, "curly cat curly tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(1, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    server.AddDocument(3, "big cat fancy collar"s, DocumentStatus::ACTUAL, { 1, 2, 8 });
+    server.AddDocument(2, "big dog sparrow"s, DocumentStatus::ACTUAL, { 1, 3, 2 });
+    ASSERT_EQUAL(server.FindTopDocuments("curly"s).size(), 2u);
+    ASSERT_EQUAL(std::get<0>(server.MatchDocument("curly cat"s, 5)).size(), 2u);
+
+    server.RemoveDocument(5);
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+    const auto documents = server.FindTopDocuments("curly"s);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT_EQUAL(documents[0].id, 1);
+
+    server.RemoveDocument(std::execution::par, 3);
+    ASSERT_EQUAL(server.GetDocumentCount(), 2);
+    ASSERT(server.FindTopDocuments(std::execution::par, "cat"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("fancy collar"s).size(), 1u);
+    ASSERT(server.GetWordFrequencies(3).empty());
+
+    // Удаление несуществующего документа ничего не меняет
+    server.RemoveDocument(42);
+    ASSERT_EQUAL(server.GetDocumentCount(), 2);
+}
+void TestWordFrequencies() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    const auto word_freqs = server.GetWordFrequencies(1);
+    ASSERT_EQUAL(word_freqs.size(), 3u);
+    ASSERT(std::abs(word_freqs.at("curly"sv) - 0.5) < 1e-6);
+    ASSERT(std::abs(word_freqs.at("tail"sv) - 0.25) < 1e-6);
+    ASSERT(server.GetWordFrequencies(3).empty());
+
+    // Найденные слова хранятся в словаре сервера и переживают строку запроса
+    std::vector<std::string_view> words;
+    {
+        const std::string query = "tail curly dog"s;
+        words = std::get<0>(server.MatchDocument(query, 1));
+    }
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(words[0], "curly"sv);
+    ASSERT_EQUAL(words[1], "tail"sv);
+}
+void TestTopDocumentsCount() {
+    SearchServer server("and with"s);
+    for (int id = 0; id < 20; ++id) {
+        server.AddDocument(id, "white cat and fancy collar"s, DocumentStatus::ACTUAL, { id % 4 });
+    }
+    server.AddDocument(20, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+    // По умолчанию возвращается не больше MAX_RESULT_DOCUMENT_COUNT документов
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 0).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 100).size(), 21u);
+
+    // При равной релевантности документы упорядочены по рейтингу, затем по id
+    const auto documents = server.FindTopDocuments("cat collar"s, DocumentStatus::ACTUAL, 7);
+    ASSERT_EQUAL(documents.size(), 7u);
+    const std::vector<int> expected_ids = { 3, 7, 11, 15, 19, 2, 6 };
+    for (size_t i = 0; i < expected_ids.size(); ++i) {
+        ASSERT_EQUAL(documents[i].id, expected_ids[i]);
+    }
+    const auto documents_par = server.FindTopDocuments(std::execution::par, "cat collar"s, DocumentStatus::ACTUAL, 7);
+    ASSERT_EQUAL(documents_par.size(), documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_EQUAL(documents_par[i].id, documents[i].id);
+    }
+}
+void TestDynamicPruning() {
+    SearchServer server("and with"s);
+    std::mt19937 generator(17);
+    // Небольшой словарь с неравномерными частотами слов
+    const auto random_word = [&generator]() {
+        const int index = std::uniform_int_distribution<int>(0, 15)(generator) * std::uniform_int_distribution<int>(0, 3)(generator);
+        return "w"s + std::to_string(index);
+    };
+    for (int id = 0; id < 600; ++id) {
+        std::string text;
+        const int word_count = std::uniform_int_distribution<int>(1, 12)(generator);
+        for (int i = 0; i < word_count; ++i) {
+            text += random_word() + " "s;
+        }
+        server.AddDocument(id * 3, text, static_cast<DocumentStatus>(id % 4), { id % 11 - 5 });
+    }
+    for (int id = 0; id < 600; id += 7) {
+        server.RemoveDocument(id * 3);
+    }
+
+    const auto check_same = [](const std::vector<Document>& expected, const std::vector<Document>& actual) {
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+            ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12);
+        }
+    };
+    // Результаты с отсечением по WAND должны совпадать с полным перебором
+    for (int query_index = 0; query_index < 50; ++query_index) {
+        std::string query = random_word() + " "s + random_word() + " "s + random_word();
+        if (query_index % 3 == 0) {
+            query += " -"s + random_word();
+        }
+        for (const size_t count : { 1, 3, 5, 40, 1000 }) {
+            check_same(server.FindTopDocuments(query, DocumentStatus::ACTUAL, count),
+                server.FindTopDocuments(dynamic_pruning, query, DocumentStatus::ACTUAL, count));
+            const auto predicate = [](int document_id, DocumentStatus, int rating) { return rating > 0 || document_id % 2 == 0; };
+            check_same(server.FindTopDocuments(query, predicate, count),
+                server.FindTopDocuments(dynamic_pruning, query, predicate, count));
+        }
+        check_same(server.FindTopDocuments(query), server.FindTopDocuments(dynamic_pruning, query));
+    }
+}
+void TestParallelSearch() {
+    SearchServer server("and with"s);
+    for (int id = 0; id < 500; ++id) {
+        const std::string text = "w"s + std::to_string(id % 7) + " w"s + std::to_string(id % 11) + " w"s + std::to_string(id % 13);
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 3), { id % 9 });
+    }
+    server.RemoveDocument(14);
+    server.RemoveDocument(std::execution::par, 77);
+    // Параллельный поиск по диапазонам документов совпадает с последовательным
+    for (const std::string& query : { "w1 w3"s, "w2 w5 w10 -w4"s, "w0 w6 -w12 -w1"s, "w100"s, "-w2"s }) {
+        for (const size_t count : { 1, 5, 50, 500 }) {
+            const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, count);
+            const auto actual = server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, count);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL(actual[i].id, expected[i].id);
+                ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12);
+            }
+        }
+    }
+    const auto documents = server.FindTopDocuments(std::execution::par, "w1 -w0"s, [](int document_id, DocumentStatus, int) { return document_id % 2 == 1; }, 500);
+    ASSERT(!documents.empty());
+    for (const Document& document : documents) {
+        ASSERT_EQUAL(document.id % 2, 1);
+        ASSERT(document.id % 7 == 1 || document.id % 11 == 1 || document.id % 13 == 1);
+        ASSERT(document.id % 7 != 0 && document.id % 11 != 0 && document.id % 13 != 0);
+    }
+}
+void TestConcurrentMap() {
+    std::vector<std::string> words;
+    for (int i = 0; i < 10000; ++i) {
+        words.push_back("word"s + std::to_string(i % 257));
+    }
+    // Параллельное накопление по строковым ключам
+    ConcurrentMap<std::string, int> word_counts(16);
+    std::for_each(std::execution::par, words.begin(), words.end(), [&word_counts](const std::string& word) {
+        word_counts[word] += 1;
+        });
+    ASSERT_EQUAL(word_counts.size(), 257u);
+    ASSERT_EQUAL(word_counts.Erase("word0"s), 1u);
+    ASSERT_EQUAL(word_counts.Erase("word0"s), 0u);
+    const auto sorted = word_counts.BuildSortedVector(std::execution::par);
+    ASSERT_EQUAL(sorted.size(), 256u);
+    ASSERT(std::is_sorted(sorted.begin(), sorted.end()));
+    int total = 0;
+    word_counts.ForEach(std::execution::par, [](const std::string&, int& count) {
+        count *= 2;
+        });
+    word_counts.ForEach([&total](const std::string&, int count) {
+        total += count;
+        });
+    ASSERT_EQUAL(total, 2 * (10000 - 39));
+
+    // Все ключи с одинаковым хешем: проверяем пробирование и удаление со сдвигом
+    struct ConstantHash {
+        size_t operator()(int) const {
+            return 42;
+        }
+    };
+    ConcurrentMap<int, double, ConstantHash> colliding(1);
+    for (int key = 0; key < 100; ++key) {
+        colliding[key] += key * 0.5;
+    }
+    for (int key = 0; key < 100; key += 3) {
+        ASSERT_EQUAL(colliding.Erase(key), 1u);
+    }
+    const auto ordinary = colliding.BuildOrdinaryMap();
+    ASSERT_EQUAL(ordinary.size(), 66u);
+    for (const auto& [key, value] : ordinary) {
+        ASSERT(key % 3 != 0);
+        ASSERT(std::abs(value - key * 0.5) < 1e-12);
+    }
+}
+void TestPostingList() {
+    std::mt19937 generator(5);
+    PostingList postings;
+    std::map<uint32_t, uint32_t> expected;
+    uint32_t slot = 0;
+    // Разные промежутки между слотами дают блоки с разной шириной упаковки
+    for (int i = 0; i < 1000; ++i) {
+        slot += i % 97 == 0 ? 3000000 : std::uniform_int_distribution<uint32_t>(1, 40)(generator);
+        const uint32_t count = i % 13 == 0 ? 70000 : std::uniform_int_distribution<uint32_t>(1, 4)(generator);
+        postings.Add(slot, count, count * 0.01);
+        expected[slot] = count;
+    }
+    ASSERT_EQUAL(postings.size(), expected.size());
+
+    std::vector<std::pair<uint32_t, uint32_t>> decoded;
+    postings.ForEach([&decoded](uint32_t slot, uint32_t count) {
+        decoded.push_back({ slot, count });
+        });
+    const std::vector<std::pair<uint32_t, uint32_t>> expected_postings(expected.begin(), expected.end());
+    ASSERT(decoded == expected_postings);
+
+    // Курсор перепрыгивает блоки и останавливается на первом слоте не меньше заданного
+    PostingList::Cursor cursor(postings);
+    for (uint32_t target = 0; target < slot; target += 12345) {
+        cursor.SkipTo(target);
+        const auto iter = expected.lower_bound(target);
+        if (iter == expected.end()) {
+            ASSERT_EQUAL(cursor.GetSlot(), PostingList::Cursor::END);
+            break;
+        }
+        ASSERT_EQUAL(cursor.GetSlot(), static_cast<int64_t>(iter->first));
+        ASSERT_EQUAL(cursor.GetCount(), iter->second);
+        ASSERT(cursor.GetBlockBound(target).max_term_freq >= iter->second * 0.01);
+    }
+    ASSERT(postings.GetEncodedSize() < expected.size() * sizeof(std::pair<uint32_t, double>));
+}
+void TestTokenizer() {
+    // Эталонное разбиение: пробелы (и юникодные пробелы) разделяют слова, управляющие символы запрещены
+    const std::vector<std::string> pieces = { "a"s, "bc"s, " "s, "  "s, "\xC2\xA0"s, "\xE2\x80\x89"s, "\xC3\xA9"s, "\xD0\x9A"s };
+    const std::set<std::string> unicode_spaces = { "\xC2\xA0"s, "\xE2\x80\x89"s };
+    std::mt19937 generator(8);
+    for (int i = 0; i < 300; ++i) {
+        std::string text;
+        std::vector<std::string> expected_words;
+        std::vector<std::string> expected_unicode_words;
+        bool in_word = false;
+        bool in_unicode_word = false;
+        const int piece_count = std::uniform_int_distribution<int>(0, 150)(generator);
+        for (int j = 0; j < piece_count; ++j) {
+            const std::string& piece = pieces[std::uniform_int_distribution<size_t>(0, pieces.size() - 1)(generator)];
+            text += piece;
+            const bool is_space = piece[0] == ' ';
+            const bool is_unicode_space = is_space || unicode_spaces.count(piece);
+            if (!is_space) {
+                if (in_word) {
+                    expected_words.back() += piece;
+                }
+                else {
+                    expected_words.push_back(piece);
+                }
+            }
+            in_word = !is_space;
+            if (!is_unicode_space) {
+                if (in_unicode_word) {
+                    expected_unicode_words.back() += piece;
+                }
+                else {
+                    expected_unicode_words.push_back(piece);
+                }
+            }
+            in_unicode_word = !is_unicode_space;
+        }
+        for (const bool unicode : { false, true }) {
+            std::vector<std::string_view> words;
+            ASSERT(Tokenize(text, words, unicode));
+            const std::vector<std::string> tokenized(words.begin(), words.end());
+            ASSERT(tokenized == (unicode ? expected_unicode_words : expected_words));
+            const auto split = SplitIntoWords(text, unicode);
+            ASSERT(std::vector<std::string>(split.begin(), split.end()) == tokenized);
+        }
+        if (!text.empty()) {
+            std::string invalid_text = text;
+            invalid_text[std::uniform_int_distribution<size_t>(0, text.size() - 1)(generator)] = '\t';
+            std::vector<std::string_view> words;
+            ASSERT(!Tokenize(invalid_text, words));
+        }
+    }
+    ASSERT_EQUAL(FoldCase("Cat \xC3\x89T\xC3\x89 \xD0\x9A\xD0\xBE\xD0\xA2 \xD0\x81\xD0\xB6 \xC3\x97"sv),
+        "cat \xC3\xA9t\xC3\xA9 \xD0\xBA\xD0\xBE\xD1\x82 \xD1\x91\xD0\xB6 \xC3\x97"s);
+
+    SearchServerOptions options;
+    options.tokenizer.unicode_spaces = true;
+    options.tokenizer.fold_case = true;
+    SearchServer search_server("And"s, options);
+    search_server.AddDocument(1, "Cat\xC2\xA0" "and DOG"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat and bird"s, DocumentStatus::ACTUAL, { 1 });
+    const auto [words, status] = search_server.MatchDocument("CAT dog AND"s, 1);
+    ASSERT(words == std::vector<std::string_view>({ "cat"sv, "dog"sv }));
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat -BIRD"s).size(), 1u);
+    try {
+        search_server.AddDocument(3, "cat\ndog"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "Документ с управляющим символом должен отклоняться"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+}
+void TestDocumentText() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.GetDocumentText(1), "cat and dog"sv);
+
+    // Без исходных текстов поиск и сопоставление работают по индексу
+    SearchServerOptions options;
+    options.retain_document_text = false;
+    SearchServer compact_server("and"s, options);
+    std::string text = "cat and dog"s;
+    compact_server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+    compact_server.AddDocument(2, "bird"s, DocumentStatus::ACTUAL, { 1 });
+    text.assign(text.size(), 'x');
+    ASSERT(compact_server.GetDocumentText(1).empty());
+    const auto [words, status] = compact_server.MatchDocument("dog cat"s, 1);
+    ASSERT(words == std::vector<std::string_view>({ "cat"sv, "dog"sv }));
+    ASSERT_EQUAL(compact_server.FindTopDocuments("dog"s).size(), 1u);
+    try {
+        compact_server.GetDocumentText(3);
+        ASSERT_HINT(false, "Для несуществующего документа должно выбрасываться исключение"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+}
+
+void TestTermArena() {
+    TermArena arena;
+    std::vector<std::string> expected;
+    std::vector<std::string_view> stored;
+    for (int i = 0; i < 20000; ++i) {
+        // Изредка встречаются строки длиннее четверти блока арены
+        expected.push_back(i % 5000 == 0 ? std::string(40000, 'a' + i % 26) : std::to_string(i * 7919));
+        stored.push_back(arena.Store(expected.back()));
+    }
+    // Строки не перемещаются при перемещении арены
+    TermArena moved_arena = std::move(arena);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(stored[i], std::string_view(expected[i]));
+    }
+    ASSERT(moved_arena.GetAllocatedSize() < 4 * 40000 + 2 * 20000 * 8);
+}
+void TestSnapshot() {
+    SearchServer server("and with"s);
+    for (int id = 0; id < 2000; ++id) {
+        const std::string text = "w"s + std::to_string(id % 7) + " w"s + std::to_string(id % 11) + " and w"s + std::to_string(id % 300);
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 3), { id % 9 });
+    }
+    for (int id = 0; id < 2000; id += 9) {
+        server.RemoveDocument(id);
+    }
+    const std::string path = "search_server_test.snapshot"s;
+    server.SaveSnapshot(path);
+    const int saved_document_count = server.GetDocumentCount();
+
+    const auto check_same = [](const SearchServer& expected_server, const SearchServer& actual_server) {
+        ASSERT_EQUAL(actual_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const std::string& query : { "w1 w3"s, "w2 w5 w10 -w4"s, "w0 w299 -w6"s, "and w7"s, "w100"s }) {
+            const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 100);
+            const auto actual = actual_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 100);
+            const auto actual_pruned = actual_server.FindTopDocuments(dynamic_pruning, query, DocumentStatus::ACTUAL, 100);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            ASSERT_EQUAL(actual_pruned.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL(actual[i].id, expected[i].id);
+                ASSERT_EQUAL(actual_pruned[i].id, expected[i].id);
+                ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+            }
+        }
+        for (const int id : { 2, 501, 1999 }) {
+            ASSERT(actual_server.MatchDocument("w1 w2 w3 w4"s, id) == expected_server.MatchDocument("w1 w2 w3 w4"s, id));
+            ASSERT(actual_server.GetWordFrequencies(id) == expected_server.GetWordFrequencies(id));
+            ASSERT_EQUAL(actual_server.GetDocumentText(id), expected_server.GetDocumentText(id));
+        }
+    };
+    {
+        SearchServer opened = SearchServer::OpenSnapshot(path);
+        check_same(server, opened);
+        // Тексты документов не копируются из файла: в нём они записаны подряд
+        const std::string_view text = opened.GetDocumentText(501);
+        ASSERT(opened.GetDocumentText(502).data() == text.data() + text.size());
+
+        // Открытый снимок можно изменять, изменённые списки копируются из файла
+        for (SearchServer* target : { &server, &opened }) {
+            target->AddDocument(5000, "w1 w3 w7"s, DocumentStatus::ACTUAL, { 5 });
+            target->RemoveDocument(1);
+            target->RemoveDocument(std::execution::par, 500);
+        }
+        check_same(server, opened);
+        opened.SaveSnapshot(path + ".copy"s);
+        check_same(server, SearchServer::OpenSnapshot(path + ".copy"s, false));
+    }
+
+    // Незавершённая запись не портит предыдущий снимок и не оставляет временный файл
+    {
+        SnapshotWriter writer(path);
+        writer.WriteValue<uint64_t>(0);
+    }
+    ASSERT_EQUAL(SearchServer::OpenSnapshot(path).GetDocumentCount(), saved_document_count);
+    ASSERT(!std::ifstream(path + ".tmp"s));
+
+    // Слоты в списках документов проверяются по заголовкам блоков и, по запросу, по самим записям
+    PostingList postings;
+    for (uint32_t slot = 0; slot < 300; ++slot) {
+        postings.Add(slot, 1, 0.5);
+    }
+    ASSERT(postings.HasSlotsBelow(300, true));
+    ASSERT(!postings.HasSlotsBelow(299, false));
+    ASSERT(!postings.HasSlotsBelow(299, true));
+
+    // Число в хвосте списка длиннее пяти байтов отклоняется и без проверки контрольной суммы
+    {
+        PostingList tail_postings;
+        tail_postings.Add(0, UINT32_MAX, 1.0);
+        tail_postings.Add(1, UINT32_MAX, 1.0);
+        SnapshotWriter writer(path + ".copy"s);
+        tail_postings.Save(writer);
+        writer.Finish();
+    }
+    std::string list_bytes;
+    {
+        std::ifstream file(path + ".copy"s, std::ios::binary);
+        list_bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    SnapshotReader valid_reader(list_bytes.data(), list_bytes.size(), false);
+    ASSERT_EQUAL(PostingList::Load(valid_reader).size(), 2u);
+    const size_t tail_position = list_bytes.find("\x00\xFE\xFF\xFF\xFF\x0F\x01\xFE"s);
+    ASSERT(tail_position != std::string::npos);
+    // Число байтов-окончаний не меняется, а первое число занимает шесть байтов
+    list_bytes[tail_position] = '\x80';
+    list_bytes[tail_position + 7] = '\x7E';
+    try {
+        SnapshotReader reader(list_bytes.data(), list_bytes.size(), false);
+        PostingList::Load(reader);
+        ASSERT_HINT(false, "Слишком длинное число в хвосте должно отклоняться"s);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    // Повторяющиеся id документов отклоняются и без проверки контрольной суммы
+    {
+        SearchServer small_server(""s);
+        small_server.AddDocument(1001, "cat"s, DocumentStatus::ACTUAL, { 777777 });
+        small_server.AddDocument(1002, "dog"s, DocumentStatus::ACTUAL, { 888888 });
+        small_server.SaveSnapshot(path + ".copy"s);
+        std::fstream file(path + ".copy"s, std::ios::in | std::ios::out | std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const int32_t record[] = { 1002, 888888 };
+        const size_t position = bytes.find(std::string(reinterpret_cast<const char*>(record), sizeof(record)));
+        ASSERT(position != std::string::npos);
+        const int32_t duplicate_id = 1001;
+        file.seekp(position);
+        file.write(reinterpret_cast<const char*>(&duplicate_id), sizeof(duplicate_id));
+    }
+    try {
+        SearchServer::OpenSnapshot(path + ".copy"s, false);
+        ASSERT_HINT(false, "Снимок с повторяющимися id должен отклоняться"s);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    // Повреждённый файл не открывается
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(100);
+        file.put('\x7F');
+    }
+    try {
+        SearchServer::OpenSnapshot(path);
+        ASSERT_HINT(false, "Повреждённый снимок должен отклоняться"s);
+    }
+    catch (const std::runtime_error&) {
+    }
+    std::remove(path.c_str());
+    std::remove((path + ".copy"s).c_str());
+}
+void TestAddDocuments() {
+    std::mt19937 generator(11);
+    std::vector<std::string> texts;
+    for (int i = 0; i < 3000; ++i) {
+        std::string text;
+        for (int j = std::uniform_int_distribution<int>(0, 12)(generator); j > 0; --j) {
+            text += "w"s + std::to_string(std::uniform_int_distribution<int>(0, 400)(generator) % (i % 50 + 5)) + " and "s;
+        }
+        texts.push_back(text);
+    }
+    std::vector<NewDocument> batch;
+    SearchServer expected_server("and"s);
+    for (int i = 0; i < 3000; ++i) {
+        batch.push_back({ i * 2, texts[i], static_cast<DocumentStatus>(i % 2), { i % 10, 3 } });
+        expected_server.AddDocument(i * 2, texts[i], static_cast<DocumentStatus>(i % 2), { i % 10, 3 });
+    }
+    SearchServer sequenced_server("and"s);
+    sequenced_server.AddDocuments(batch);
+    SearchServer parallel_server("and"s);
+    parallel_server.AddDocument(1, "w1 w2"s, DocumentStatus::ACTUAL, { 1 });
+    parallel_server.RemoveDocument(1);
+    parallel_server.AddDocuments(std::execution::par, batch);
+
+    // Пакетное добавление строит тот же индекс, что и добавление по одному документу
+    for (const SearchServer* server : { &sequenced_server, &parallel_server }) {
+        ASSERT_EQUAL(server->GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const std::string& query : { "w1 w3"s, "w2 w5 w10 -w4"s, "w0 w7 -w6"s, "and"s }) {
+            const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 100);
+            const auto actual = server->FindTopDocuments(query, DocumentStatus::ACTUAL, 100);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL(actual[i].id, expected[i].id);
+                ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+                ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12);
+            }
+        }
+        for (int id = 0; id < 6000; id += 37 * 2) {
+            ASSERT(server->GetWordFrequencies(id) == expected_server.GetWordFrequencies(id));
+            ASSERT(server->MatchDocument("w1 w4 w9"s, id) == expected_server.MatchDocument("w1 w4 w9"s, id));
+        }
+    }
+
+    // Ошибка в любом документе пакета отменяет добавление всего пакета
+    const std::vector<std::vector<NewDocument>> invalid_batches = {
+        { { 10001, "cat"sv, DocumentStatus::ACTUAL, {} }, { 10001, "dog"sv, DocumentStatus::ACTUAL, {} } },
+        { { 10001, "cat"sv, DocumentStatus::ACTUAL, {} }, { 0, "dog"sv, DocumentStatus::ACTUAL, {} } },
+        { { 10001, "cat"sv, DocumentStatus::ACTUAL, {} }, { -1, "dog"sv, DocumentStatus::ACTUAL, {} } },
+        { { 10001, "cat"sv, DocumentStatus::ACTUAL, {} }, { 10002, "d\x01og"sv, DocumentStatus::ACTUAL, {} } },
+    };
+    for (const auto& invalid_batch : invalid_batches) {
+        try {
+            parallel_server.AddDocuments(std::execution::par, invalid_batch);
+            ASSERT_HINT(false, "Некорректный пакет должен отклоняться"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        ASSERT_EQUAL(parallel_server.GetDocumentCount(), 3000);
+        ASSERT(parallel_server.FindTopDocuments("cat"s).empty());
+    }
+
+    // Из нескольких ошибок сообщается о первой по порядку документов, как при добавлении по одному
+    const auto add_error = [&parallel_server](const std::vector<NewDocument>& invalid_batch) {
+        try {
+            parallel_server.AddDocuments(std::execution::par, invalid_batch);
+        }
+        catch (const std::invalid_argument& e) {
+            return std::string(e.what());
+        }
+        return std::string();
+    };
+    ASSERT_EQUAL(add_error({ { 10001, "d\x01og"sv, DocumentStatus::ACTUAL, {} }, { 0, "cat"sv, DocumentStatus::ACTUAL, {} },
+        { 10002, "cat"sv, DocumentStatus::ACTUAL, {} } }), "Document must not contain special characters"s);
+    ASSERT_EQUAL(add_error({ { 0, "cat"sv, DocumentStatus::ACTUAL, {} }, { 10001, "d\x01og"sv, DocumentStatus::ACTUAL, {} } }),
+        "Document with this id already exists"s);
+    ASSERT_EQUAL(add_error({ { 10001, "cat"sv, DocumentStatus::ACTUAL, {} }, { -1, "d\x01og"sv, DocumentStatus::ACTUAL, {} } }),
+        "Document id must be non-negative"s);
+}
+void TestIngestPipeline() {
+    SearchServer expected_server("and"s);
+    std::string dump;
+    for (int id = 0; id < 5000; ++id) {
+        std::string text = "w"s + std::to_string(id % 17) + " and w"s + std::to_string(id % 31);
+        if (id == 2500) {
+            // Строка длиннее блока чтения
+            for (int i = 0; i < 500; ++i) {
+                text += " long"s + std::to_string(i);
+            }
+        }
+        const std::vector<int> ratings = { id % 5, id % 3 };
+        expected_server.AddDocument(id, text, static_cast<DocumentStatus>(id % 4), ratings);
+        dump += std::to_string(id) + "\t"s + (id % 2 == 0 ? std::to_string(id % 4) : (id % 4 == 1 ? "IRRELEVANT"s : "REMOVED"s))
+            + "\t"s + std::to_string(ratings[0]) + " "s + std::to_string(ratings[1]) + "\t"s + text + (id % 7 == 0 ? "\r\n"s : "\n"s);
+        if (id % 1000 == 0) {
+            dump += "\n"s;
+        }
+    }
+    dump.pop_back();
+
+    // Маленькие блоки и очереди заставляют стадии конвейера ждать друг друга
+    IngestOptions options;
+    options.chunk_size = 1000;
+    options.tokenizer_count = 3;
+    options.queue_capacity = 1;
+    SearchServer server("and"s);
+    std::istringstream input(dump);
+    const IngestStats stats = IngestDocuments(server, input, options);
+    ASSERT_EQUAL(stats.document_count, 5000u);
+    ASSERT_EQUAL(stats.byte_count, dump.size());
+    ASSERT_EQUAL(server.GetDocumentCount(), 5000);
+    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::REMOVED }) {
+        const auto expected = expected_server.FindTopDocuments("w3 w5 long7"s, status, 50);
+        const auto actual = server.FindTopDocuments("w3 w5 long7"s, status, 50);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+            ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12);
+        }
+    }
+    ASSERT(server.GetWordFrequencies(2500) == expected_server.GetWordFrequencies(2500));
+
+    // Ошибки разбора и проверки документов сообщают номера строк
+    for (const std::string& invalid_dump : { "1\tACTUAL\t1\tcat\n2\tSOLD\t1\tdog\n"s, "1\tACTUAL\t1\tcat\n1\tACTUAL\t2\tdog"s }) {
+        SearchServer invalid_server(""s);
+        std::istringstream invalid_input(invalid_dump);
+        try {
+            IngestDocuments(invalid_server, invalid_input, options);
+            ASSERT_HINT(false, "Некорректная строка должна отклоняться"s);
+        }
+        catch (const std::invalid_argument& error) {
+            ASSERT(std::string(error.what()).find("ine"s) != std::string::npos);
+        }
+    }
+
+    // Добавляются все блоки до первого ошибочного по порядку ввода, и сообщается его ошибка,
+    // даже если более поздний блок сломался раньше
+    std::string failing_dump;
+    for (int id = 0; id < 2000; ++id) {
+        const int line_id = id == 400 ? 0 : id;
+        failing_dump += std::to_string(line_id) + (id == 1500 ? "\tSOLD\t1\tcat\n"s : "\tACTUAL\t1\tcat\n"s);
+    }
+    std::optional<int> added_count;
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        SearchServer failing_server(""s);
+        std::istringstream failing_input(failing_dump);
+        try {
+            IngestDocuments(failing_server, failing_input, options);
+            ASSERT_HINT(false, "Некорректная строка должна отклоняться"s);
+        }
+        catch (const std::invalid_argument& error) {
+            ASSERT(std::string(error.what()).find("already exists"s) != std::string::npos);
+        }
+        ASSERT(failing_server.GetDocumentCount() > 300 && failing_server.GetDocumentCount() <= 400);
+        ASSERT_EQUAL(failing_server.GetDocumentCount(), added_count.value_or(failing_server.GetDocumentCount()));
+        added_count = failing_server.GetDocumentCount();
+    }
+}
+void TestVersionedSearchServer() {
+    VersionedSearchServer server("and"s);
+    const int add_count = 200;
+    const int remove_count = 100;
+    // Версия однозначно определяет число документов: сначала пары добавляются, затем удаляются
+    const auto expected_document_count = [&](uint64_t version) {
+        const int updates = static_cast<int>(version);
+        return updates <= add_count ? 2 * updates : 2 * (add_count - (updates - add_count));
+    };
+
+    std::atomic<bool> done = false;
+    std::atomic<int> inconsistent_reads = 0;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 2; ++i) {
+        readers.emplace_back([&]() {
+            uint64_t last_version = 0;
+            while (!done.load()) {
+                const auto handle = server.Read();
+                const int document_count = handle->GetDocumentCount();
+                const auto documents = handle->FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 1000);
+                if (handle.GetVersion() < last_version
+                    || document_count != expected_document_count(handle.GetVersion())
+                    || static_cast<int>(documents.size()) != document_count / 2) {
+                    ++inconsistent_reads;
+                }
+                last_version = handle.GetVersion();
+            }
+        });
+    }
+    for (int i = 0; i < add_count; ++i) {
+        server.Update([i](SearchServer& instance) {
+            instance.AddDocument(2 * i, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+            instance.AddDocument(2 * i + 1, "dog"s, DocumentStatus::ACTUAL, { 2 });
+        });
+    }
+    for (int i = 0; i < remove_count; ++i) {
+        server.Update([i](SearchServer& instance) {
+            instance.RemoveDocument(2 * i);
+            instance.RemoveDocument(2 * i + 1);
+        });
+    }
+    done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL(inconsistent_reads.load(), 0);
+    ASSERT_EQUAL(server.GetVersion(), static_cast<uint64_t>(add_count + remove_count));
+
+    // Неудачное обновление применяется к обоим экземплярам одинаково
+    try {
+        server.Update([](SearchServer& instance) {
+            instance.AddDocument(1000, "cat"s, DocumentStatus::ACTUAL, { 1 });
+            instance.AddDocument(1000, "cat"s, DocumentStatus::ACTUAL, { 1 });
+        });
+        ASSERT_HINT(false, "Повторный id должен отклоняться"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+    for (int i = 0; i < 2; ++i) {
+        server.AddDocument(1001 + i, "cat"s, DocumentStatus::ACTUAL, { 1 });
+        const auto handle = server.Read();
+        ASSERT_EQUAL(handle->GetDocumentCount(), 2 * (add_count - remove_count) + 2 + i);
+        ASSERT_EQUAL(handle->FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 1000).size(), static_cast<size_t>(add_count - remove_count + 2 + i));
+    }
+
+    // Ошибка, возникшая только при повторном применении ко второму экземпляру, не теряется
+    int application_count = 0;
+    try {
+        server.Update([&application_count](SearchServer&) {
+            if (++application_count == 2) {
+                throw std::bad_alloc();
+            }
+        });
+        ASSERT_HINT(false, "Ошибка второго экземпляра должна сообщаться"s);
+    }
+    catch (const std::bad_alloc&) {
+    }
+    ASSERT_EQUAL(application_count, 2);
+}
+void TestTombstones() {
+    SearchServerOptions options;
+    options.compaction.automatic = false;
+    options.compaction.min_dead_documents = 50;
+    options.compaction.min_dead_fraction = 0.1;
+    SearchServer server("and"s, options);
+    SearchServer expected_server("and"s);
+    std::mt19937 generator(14);
+    std::vector<std::string> texts;
+    for (int id = 0; id < 1000; ++id) {
+        std::string text;
+        for (int i = 0; i < 6; ++i) {
+            text += "w"s + std::to_string(std::uniform_int_distribution<int>(0, 40)(generator)) + " "s;
+        }
+        texts.push_back(text);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 7 });
+    }
+    for (int id = 0; id < 1000; ++id) {
+        if (id % 3 == 0) {
+            server.RemoveDocument(id);
+        }
+        else {
+            expected_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 7 });
+        }
+    }
+    // Удалённый документ можно добавить снова
+    server.AddDocument(999, texts[999], DocumentStatus::ACTUAL, { 999 % 7 });
+    expected_server.AddDocument(999, texts[999], DocumentStatus::ACTUAL, { 999 % 7 });
+
+    // До и после сжатия результаты и IDF совпадают с индексом, в котором удалённых документов не было
+    const auto check_same_results = [&]() {
+        ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const std::string& query : { "w1 w2 w3"s, "w5 -w6"s, "w7 w8 w9 w10 w11"s }) {
+            const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 30);
+            for (const auto& actual : { server.FindTopDocuments(query, DocumentStatus::ACTUAL, 30),
+                server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, 30),
+                server.FindTopDocuments(dynamic_pruning, query, DocumentStatus::ACTUAL, 30) }) {
+                ASSERT_EQUAL(actual.size(), expected.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL(actual[i].id, expected[i].id);
+                    ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12);
+                }
+            }
+        }
+        ASSERT(server.MatchDocument("w1 w2 w3"s, 1) == expected_server.MatchDocument("w1 w2 w3"s, 1));
+        try {
+            server.MatchDocument("w1"s, 3);
+            ASSERT_HINT(false, "Удалённый документ не должен находиться"s);
+        }
+        catch (const std::out_of_range&) {
+        }
+    };
+    ASSERT(server.NeedsCompaction());
+    check_same_results();
+    server.Compact(std::execution::par);
+    ASSERT(!server.NeedsCompaction());
+    check_same_results();
+
+    // Автоматическое сжатие запускается при удалении, когда достигнуты пороги
+    options.compaction.automatic = true;
+    SearchServer automatic_server(""s, options);
+    for (int id = 0; id < 100; ++id) {
+        automatic_server.AddDocument(id, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    for (int id = 0; id < 49; ++id) {
+        automatic_server.RemoveDocument(id);
+    }
+    ASSERT(!automatic_server.NeedsCompaction());
+    automatic_server.RemoveDocument(49);
+    ASSERT(!automatic_server.NeedsCompaction());
+    ASSERT_EQUAL(automatic_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 100).size(), 50u);
+
+    // В фоновом режиме сжатие выполняет отдельный поток
+    options.compaction.automatic = false;
+    VersionedSearchServer versioned_server(""s, options);
+    for (int id = 0; id < 100; ++id) {
+        versioned_server.AddDocument(id, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    for (int id = 0; id < 60; ++id) {
+        versioned_server.RemoveDocument(id);
+    }
+    for (int attempt = 0; attempt < 1000 && versioned_server.Read()->NeedsCompaction(); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT(!versioned_server.Read()->NeedsCompaction());
+    ASSERT_EQUAL(versioned_server.Read()->FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 100).size(), 40u);
+}
+void TestInverseDocumentFreqs() {
+    SearchServerOptions options;
+    options.tokenizer.fold_case = true;
+    SearchServer server("and"s, options);
+    const auto expected_idf = [](int document_count, int word_document_count) {
+        return std::log(document_count * 1.0 / word_document_count);
+    };
+    server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "Cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocuments({ { 3, "dog bird"sv, DocumentStatus::BANNED, { 1 } }, { 4, "bird"sv, DocumentStatus::ACTUAL, { 1 } } });
+    ASSERT(std::abs(server.GetInverseDocumentFreq("CAT"s) - expected_idf(4, 2)) < 1e-12);
+    ASSERT(std::abs(server.GetInverseDocumentFreq("bird"s) - expected_idf(4, 2)) < 1e-12);
+    ASSERT_EQUAL(server.GetInverseDocumentFreq("and"s), 0.0);
+    ASSERT_EQUAL(server.GetInverseDocumentFreq("fox"s), 0.0);
+
+    // Значения IDF обновляются при удалении документов
+    server.RemoveDocument(2);
+    ASSERT(std::abs(server.GetInverseDocumentFreq("cat"s) - expected_idf(3, 1)) < 1e-12);
+    ASSERT(std::abs(server.GetInverseDocumentFreq("dog"s) - expected_idf(3, 2)) < 1e-12);
+    const auto documents = server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT(std::abs(documents[0].relevance - expected_idf(3, 1) / 2) < 1e-12);
+    server.RemoveDocument(1);
+    ASSERT_EQUAL(server.GetInverseDocumentFreq("cat"s), 0.0);
+    ASSERT(server.FindTopDocuments("cat"s).empty());
+}
+void TestQueryCache() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, { 8 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5 });
+    QueryCacheOptions options;
+    options.capacity = 2;
+    options.shard_count = 1;
+    QueryCache cache(server, options);
+
+    const auto check_same = [](const std::vector<Document>& expected, const std::vector<Document>& actual) {
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+        }
+    };
+    check_same(server.FindTopDocuments("fluffy cat"s), cache.FindTopDocuments("fluffy cat"s));
+    // Порядок слов, повторы и стоп-слова не меняют ключ запроса
+    check_same(server.FindTopDocuments("fluffy cat"s), cache.FindTopDocuments("cat and fluffy cat"s));
+    ASSERT_EQUAL(cache.GetStats().hits, 1u);
+    ASSERT_EQUAL(cache.GetStats().misses, 1u);
+    // Статус, число результатов и предикат входят в ключ
+    check_same(server.FindTopDocuments("dog"s, DocumentStatus::BANNED), cache.FindTopDocuments("dog"s, DocumentStatus::BANNED));
+    check_same(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 1), cache.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 1));
+    const auto even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    check_same(server.FindTopDocuments("cat"s, even), cache.FindTopDocuments("cat"s, 2, even));
+    ASSERT_EQUAL(cache.GetStats().misses, 4u);
+
+    // Изменение индекса делает сохранённые результаты недействительными
+    check_same(server.FindTopDocuments("cat"s, even), cache.FindTopDocuments("cat"s, 2, even));
+    ASSERT_EQUAL(cache.GetStats().hits, 2u);
+    server.AddDocument(4, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    check_same(server.FindTopDocuments("cat"s, even), cache.FindTopDocuments("cat"s, 2, even));
+    ASSERT_EQUAL(cache.GetStats().misses, 5u);
+    server.RemoveDocument(4);
+    check_same(server.FindTopDocuments("cat"s, even), cache.FindTopDocuments("cat"s, 2, even));
+    ASSERT_EQUAL(cache.GetStats().misses, 6u);
+
+    // Кэш используется очередью запросов и пакетной обработкой
+    RequestQueue request_queue(cache);
+    request_queue.AddFindRequest("curly dog"s);
+    request_queue.AddFindRequest("dog curly"s);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 2);
+    const std::vector<std::string> queries = { "fluffy"s, "white cat"s, "fluffy"s, "cat white"s };
+    const auto results = ProcessQueries(cache, queries);
+    ASSERT_EQUAL(results.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        check_same(server.FindTopDocuments(queries[i]), results[i]);
+    }
+    ASSERT_EQUAL(cache.GetStats().hits + cache.GetStats().misses, 14u);
+
+    // Сегментов не больше ёмкости, поэтому кэш не хранит больше результатов, чем задано
+    QueryCacheOptions small_options;
+    small_options.capacity = 3;
+    small_options.shard_count = 16;
+    QueryCache small_cache(server, small_options);
+    const std::vector<std::string> distinct_queries = { "cat"s, "dog"s, "fluffy"s, "white"s, "tail"s, "eyes"s, "collar"s, "fancy"s };
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const std::string& query : distinct_queries) {
+            small_cache.FindTopDocuments(query);
+        }
+    }
+    ASSERT(small_cache.GetStats().hits <= 3u);
+    QueryCacheOptions empty_options;
+    empty_options.capacity = 0;
+    QueryCache empty_cache(server, empty_options);
+    check_same(server.FindTopDocuments("cat"s), empty_cache.FindTopDocuments("cat"s));
+    check_same(server.FindTopDocuments("cat"s), empty_cache.FindTopDocuments("cat"s));
+    ASSERT_EQUAL(empty_cache.GetStats().hits, 0u);
+}
+void TestProcessQueries() {
+    SearchServer server("and with"s);
+    int id = 0;
+    for (const std::string& text : { "funny pet and nasty rat"s, "funny pet with curly hair"s, "funny pet and not very nasty rat"s,
+        "pet with rat and rat and rat"s, "nasty rat with curly hair"s }) {
+        server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+    }
+    // Повторы и запросы, совпадающие после разбора, вычисляются один раз
+    const std::vector<std::string> queries = { "nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s,
+        "rat nasty -not"s, "curly hair"s, "hair and curly unknown"s, ""s };
+    const auto results = ProcessQueries(server, queries);
+    const auto joined = ProcessQueriesJoined(server, queries);
+    ASSERT_EQUAL(results.size(), queries.size());
+    size_t joined_index = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j, ++joined_index) {
+            ASSERT_EQUAL(results[i][j].id, expected[j].id);
+            ASSERT_EQUAL(results[i][j].relevance, expected[j].relevance);
+            ASSERT_EQUAL(joined[joined_index].id, expected[j].id);
+        }
+    }
+    ASSERT_EQUAL(joined.size(), joined_index);
+
+    try {
+        ProcessQueries(server, { "curly"s, "curly --hair"s });
+        ASSERT_HINT(false, "Некорректный запрос должен отклоняться"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // С кэшем исключение тоже не выходит из параллельного алгоритма, сообщается первый по порядку некорректный запрос
+    QueryCache query_cache(server);
+    try {
+        ProcessQueriesJoined(query_cache, { "curly"s, "curly --hair"s, "rat"s, "--nasty"s });
+        ASSERT_HINT(false, "Некорректный запрос должен отклоняться"s);
+    }
+    catch (const std::invalid_argument& e) {
+        ASSERT_EQUAL(std::string(e.what()), "Query word --hair is invalid"s);
+    }
+    ASSERT_EQUAL(ProcessQueries(query_cache, queries).size(), queries.size());
+}
+void TestQueryContext() {
+    SmallVector<int, 2> numbers;
+    for (int i = 0; i < 5; ++i) {
+        numbers.push_back(i);
+    }
+    numbers.erase(numbers.begin() + 1, numbers.begin() + 3);
+    ASSERT(std::vector<int>(numbers.begin(), numbers.end()) == std::vector<int>({ 0, 3, 4 }));
+    SmallVector<int, 2> moved = std::move(numbers);
+    ASSERT_EQUAL(moved.size(), 3u);
+    ASSERT(numbers.empty());
+
+    SearchServerOptions options;
+    options.tokenizer.fold_case = true;
+    SearchServer server("and"s, options);
+    std::string long_query;
+    for (int id = 0; id < 40; ++id) {
+        const std::string word = "Word"s + std::to_string(id);
+        server.AddDocument(id, word + " and shared"s, DocumentStatus::ACTUAL, { id });
+        long_query += word + " "s;
+    }
+    // Один контекст переиспользуется запросами разной длины, включая не помещающиеся во встроенные буферы
+    SearchServer::QueryContext context;
+    for (const std::string& query : { "word1 SHARED"s, long_query + "-word3"s, "shared -word0"s, long_query }) {
+        const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50);
+        const auto actual = server.FindTopDocuments(context, query, DocumentStatus::ACTUAL, 50);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].relevance, expected[i].relevance);
+        }
+        ASSERT(server.MatchDocument(context, query, 5) == server.MatchDocument(query, 5));
+    }
+    ASSERT_EQUAL(server.FindTopDocuments(context, "shared"s, [](int document_id, DocumentStatus, int) {
+        return document_id < 3;
+        }).size(), 3u);
+    try {
+        server.FindTopDocuments(context, "word1 --word2"s);
+        ASSERT_HINT(false, "Некорректный запрос должен отклоняться"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+void TestStatusPartitions() {
+    const DocumentStatus statuses[] = { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+        DocumentStatus::BANNED, DocumentStatus::REMOVED };
+    SearchServerOptions options;
+    options.compaction.automatic = false;
+    SearchServer server("and"s, options);
+    std::mt19937 generator(19);
+    std::vector<std::string> texts;
+    std::vector<DocumentStatus> document_statuses;
+    std::vector<NewDocument> batch;
+    for (int id = 0; id < 1000; ++id) {
+        std::string text;
+        for (int i = 0; i < 6; ++i) {
+            text += "w"s + std::to_string(std::uniform_int_distribution<int>(0, 40)(generator)) + " "s;
+        }
+        texts.push_back(text);
+        document_statuses.push_back(statuses[id % 10 == 0 ? id / 10 % 4 : 0]);
+    }
+    for (int id = 0; id < 500; ++id) {
+        server.AddDocument(id, texts[id], document_statuses[id], { id % 7 });
+    }
+    for (int id = 500; id < 1000; ++id) {
+        batch.push_back({ id, texts[id], document_statuses[id], { id % 7 } });
+    }
+    server.AddDocuments(std::execution::par, batch);
+
+    // Смена статуса переносит документ в другой раздел индекса
+    for (int id = 0; id < 1000; id += 13) {
+        document_statuses[id] = statuses[(static_cast<int>(document_statuses[id]) + 1) % 4];
+        server.SetDocumentStatus(id, document_statuses[id]);
+    }
+    server.SetDocumentStatus(1, document_statuses[1]);
+    try {
+        server.SetDocumentStatus(1000, DocumentStatus::BANNED);
+        ASSERT_HINT(false, "Смена статуса несуществующего документа должна бросать исключение"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+    ASSERT(std::get<DocumentStatus>(server.MatchDocument("w1"s, 13)) == document_statuses[13]);
+
+    SearchServer expected_server("and"s);
+    for (int id = 0; id < 1000; ++id) {
+        expected_server.AddDocument(id, texts[id], document_statuses[id], { id % 7 });
+    }
+
+    // Поиск по статусу совпадает с поиском по предикату и с индексом, построенным заново
+    const auto check_same_results = [&](const SearchServer& server) {
+        for (const std::string& query : { "w1 w2 w3"s, "w5 -w6"s, "w7 w8 w9 w10 w11"s }) {
+            for (const DocumentStatus status : statuses) {
+                const auto expected = expected_server.FindTopDocuments(query,
+                    [status](int, DocumentStatus document_status, int) {
+                        return document_status == status;
+                    }, 30);
+                for (const auto& actual : { server.FindTopDocuments(query, status, 30),
+                    server.FindTopDocuments(std::execution::par, query, status, 30),
+                    server.FindTopDocuments(dynamic_pruning, query, status, 30) }) {
+                    ASSERT_EQUAL(actual.size(), expected.size());
+                    for (size_t i = 0; i < expected.size(); ++i) {
+                        ASSERT_EQUAL(actual[i].id, expected[i].id);
+                        ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12);
+                    }
+                }
+            }
+            const auto even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+            const auto expected = expected_server.FindTopDocuments(query, even, 30);
+            const auto actual = server.FindTopDocuments(dynamic_pruning, query, even, 30);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL(actual[i].id, expected[i].id);
+            }
+        }
+        for (int id = 0; id < 1000; id += 13) {
+            ASSERT(server.MatchDocument("w1 w2 w3 w4"s, id) == expected_server.MatchDocument("w1 w2 w3 w4"s, id));
+        }
+    };
+    check_same_results(server);
+
+    const std::string path = "search_server_status_test.snapshot"s;
+    server.SaveSnapshot(path);
+    check_same_results(SearchServer::OpenSnapshot(path));
+    std::remove(path.c_str());
+
+    server.Compact();
+    check_same_results(server);
+}
+
+void TestDocumentColumns() {
+    SearchServerOptions options;
+    options.compaction.automatic = false;
+    SearchServer server(""s, options);
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id * 3, "cat dog"s, id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id });
+    }
+    for (int id = 0; id < 100; id += 5) {
+        server.RemoveDocument(id * 3);
+    }
+    server.SetDocumentStatus(3, DocumentStatus::IRRELEVANT);
+
+    // Предикат получает рейтинг и статус своего документа до и после сжатия
+    const auto check_columns = [&]() {
+        ASSERT_EQUAL(server.GetDocumentCount(), 80);
+        ASSERT_EQUAL(std::distance(server.begin(), server.end()), 80);
+        int previous_id = -1;
+        for (const int document_id : server) {
+            ASSERT(document_id > previous_id && document_id % 3 == 0 && document_id % 15 != 0);
+            previous_id = document_id;
+        }
+        int checked = 0;
+        const auto documents = server.FindTopDocuments("cat"s, [&](int document_id, DocumentStatus status, int rating) {
+            ASSERT_EQUAL(rating, document_id / 3);
+            const DocumentStatus expected_status = document_id == 3 ? DocumentStatus::IRRELEVANT
+                : document_id / 3 % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            ASSERT(status == expected_status);
+            ++checked;
+            return true;
+            }, 100);
+        ASSERT_EQUAL(checked, 80);
+        ASSERT_EQUAL(documents.size(), 80u);
+        for (const Document& document : documents) {
+            ASSERT_EQUAL(document.rating, document.id / 3);
+        }
+        ASSERT(std::get<DocumentStatus>(server.MatchDocument("cat"s, 3)) == DocumentStatus::IRRELEVANT);
+        ASSERT(std::get<DocumentStatus>(server.MatchDocument(std::execution::par, "cat"s, 12)) == DocumentStatus::BANNED);
+    };
+    check_columns();
+    server.Compact();
+    check_columns();
+}
+
+void TestDuplicatePolicy() {
+    SearchServerOptions options;
+    options.duplicates = DuplicatePolicy::REJECT;
+    SearchServer rejecting_server("and"s, options);
+    rejecting_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1 });
+    try {
+        rejecting_server.AddDocument(2, "rat rat nasty pet funny"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "Дубликат должен отклоняться"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+    // Подмножество слов дубликатом не является
+    rejecting_server.AddDocument(2, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(rejecting_server.GetDocumentCount(), 2);
+
+    // Пакет отклоняется целиком, если дублирует индекс или сам себя
+    const std::vector<NewDocument> batch_with_index_duplicate = {
+        { 3, "curly hair"sv, DocumentStatus::ACTUAL, { 1 } }, { 4, "pet funny"sv, DocumentStatus::ACTUAL, { 1 } } };
+    const std::vector<NewDocument> batch_with_own_duplicate = {
+        { 3, "curly hair"sv, DocumentStatus::ACTUAL, { 1 } }, { 4, "hair curly"sv, DocumentStatus::ACTUAL, { 1 } } };
+    for (const auto& batch : { batch_with_index_duplicate, batch_with_own_duplicate }) {
+        try {
+            rejecting_server.AddDocuments(std::execution::par, batch);
+            ASSERT_HINT(false, "Пакет с дубликатом должен отклоняться"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        ASSERT_EQUAL(rejecting_server.GetDocumentCount(), 2);
+        ASSERT(rejecting_server.FindTopDocuments("curly hair"s).empty());
+    }
+    // Отклонённый пакет не добавляет в индекс ни слов, ни списков документов
+    const auto snapshot_bytes = [&rejecting_server](const std::string& path) {
+        rejecting_server.SaveSnapshot(path);
+        std::ifstream file(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+        std::remove(path.c_str());
+        return bytes;
+    };
+    const std::string bytes_before = snapshot_bytes("search_server_rejected_batch_test.snapshot"s);
+    try {
+        rejecting_server.AddDocuments({ { 3, "curly wig"sv, DocumentStatus::BANNED, { 1 } },
+            { 4, "funny pet"sv, DocumentStatus::IRRELEVANT, { 1 } } });
+        ASSERT_HINT(false, "Пакет с дубликатом должен отклоняться"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+    ASSERT(snapshot_bytes("search_server_rejected_batch_test.snapshot"s) == bytes_before);
+    // После удаления документа такой же можно добавить снова
+    rejecting_server.RemoveDocument(2);
+    rejecting_server.AddDocuments({ { 4, "pet funny"sv, DocumentStatus::ACTUAL, { 1 } } });
+    ASSERT_EQUAL(rejecting_server.GetDocumentCount(), 2);
+
+    options.duplicates = DuplicatePolicy::FLAG;
+    SearchServer flagging_server("and"s, options);
+    flagging_server.AddDocument(5, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1 });
+    flagging_server.AddDocument(3, "rat nasty pet funny"s, DocumentStatus::ACTUAL, { 1 });
+    flagging_server.AddDocuments({ { 7, "nasty rat funny pet"sv, DocumentStatus::ACTUAL, { 1 } },
+        { 8, "curly hair"sv, DocumentStatus::ACTUAL, { 1 } } });
+    ASSERT_EQUAL(flagging_server.GetDocumentCount(), 4);
+    ASSERT_EQUAL(*flagging_server.FindDuplicate(5), 3);
+    ASSERT_EQUAL(*flagging_server.FindDuplicate(3), 5);
+    ASSERT_EQUAL(*flagging_server.FindDuplicate(7), 3);
+    ASSERT(!flagging_server.FindDuplicate(8));
+    ASSERT(flagging_server.GetWordSetFingerprint(5) == flagging_server.GetWordSetFingerprint(7));
+    ASSERT(flagging_server.GetWordSetFingerprint(5) != flagging_server.GetWordSetFingerprint(8));
+    ASSERT(flagging_server.HaveSameWords(5, 7) && !flagging_server.HaveSameWords(5, 8));
+
+    // Индекс отпечатков восстанавливается из снимка
+    const std::string path = "search_server_duplicates_test.snapshot"s;
+    flagging_server.SaveSnapshot(path);
+    SearchServer restored_server = SearchServer::OpenSnapshot(path);
+    std::remove(path.c_str());
+    flagging_server.RemoveDocument(3);
+    ASSERT_EQUAL(*flagging_server.FindDuplicate(7), 5);
+    ASSERT_EQUAL(*restored_server.FindDuplicate(7), 3);
+
+    RemoveDuplicates(restored_server);
+    ASSERT_EQUAL(restored_server.GetDocumentCount(), 2);
+    ASSERT(!restored_server.FindDuplicate(3));
+    ASSERT_EQUAL(restored_server.GetDocumentText(8), "curly hair"s);
+
+    SearchServer allowing_server("and"s);
+    allowing_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    allowing_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(!allowing_server.FindDuplicate(1));
+}
+
+void TestNearDuplicates() {
+    SearchServer server("and"s);
+    std::mt19937 generator(22);
+    const auto random_words = [&generator](int count) {
+        std::vector<std::string> words;
+        for (int i = 0; i < count; ++i) {
+            words.push_back("w"s + std::to_string(std::uniform_int_distribution<int>(0, 100000)(generator)));
+        }
+        return words;
+    };
+    const auto join = [](const std::vector<std::string>& words) {
+        std::string text;
+        for (const std::string& word : words) {
+            text += word + " "s;
+        }
+        return text;
+    };
+    // Каждый пятый документ - копия предыдущего с одним-тремя заменёнными словами
+    std::vector<std::vector<std::string>> texts;
+    for (int id = 0; id < 300; ++id) {
+        std::vector<std::string> words = random_words(30);
+        if (id % 5 == 4) {
+            words = texts.back();
+            for (const std::string& word : random_words(id % 3 + 1)) {
+                words[std::uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] = word;
+            }
+        }
+        texts.push_back(words);
+        server.AddDocument(id, join(words), DocumentStatus::ACTUAL, { 1 });
+    }
+
+    // Найденные пары совпадают с полным перебором
+    NearDuplicateIndex index(server);
+    std::vector<std::pair<int, int>> expected_pairs;
+    for (int lhs = 0; lhs < 300; ++lhs) {
+        for (int rhs = lhs + 1; rhs < 300; ++rhs) {
+            if (server.GetWordSetSimilarity(lhs, rhs) >= 0.8) {
+                expected_pairs.emplace_back(lhs, rhs);
+            }
+        }
+    }
+    ASSERT(expected_pairs.size() >= 40u);
+    ASSERT(index.FindNearDuplicatePairs() == expected_pairs);
+    ASSERT(index.FindNearDuplicates(3) == std::vector<int>{ 4 });
+    ASSERT(index.FindNearDuplicates(4) == std::vector<int>{ 3 });
+    ASSERT(index.FindNearDuplicates(5).empty());
+    ASSERT(std::abs(server.GetWordSetSimilarity(0, 0) - 1.0) < 1e-12);
+
+    // Индекс обновляется при добавлении и удалении документов
+    server.AddDocument(1000, join(texts[0]), DocumentStatus::ACTUAL, { 1 });
+    index.AddDocument(1000);
+    ASSERT(index.FindNearDuplicates(0) == std::vector<int>{ 1000 });
+    server.RemoveDocument(0);
+    index.RemoveDocument(0);
+    ASSERT(index.FindNearDuplicates(1000).empty());
+    index.RemoveDocument(0);
+
+    RemoveNearDuplicates(server);
+    ASSERT_EQUAL(server.GetDocumentCount(), 300 - static_cast<int>(expected_pairs.size()));
+    ASSERT(NearDuplicateIndex(server).FindNearDuplicatePairs().empty());
+    ASSERT_EQUAL(server.GetDocumentCount(), std::distance(server.begin(), server.end()));
+    ASSERT(server.FindTopDocuments(join(texts[4])).size() > 0);
+}
+
+void TestMatchDocumentBatch() {
+    SearchServerOptions options;
+    options.compaction.automatic = false;
+    SearchServer server("and in"s, options);
+    const std::vector<std::string> texts = { "white cat and fancy collar"s, "fluffy cat fluffy tail"s,
+        "groomed dog expressive eyes"s, "groomed starling evgeny"s, "nasty rat with curly tail"s };
+    std::vector<int> document_ids;
+    for (int id = 0; id < 50; ++id) {
+        server.AddDocument(id, texts[id % texts.size()] + " word"s + std::to_string(id % 7), DocumentStatus::ACTUAL, { id });
+        document_ids.push_back(49 - id);
+    }
+    const std::string query = "fluffy groomed cat tail -collar word3 word3 -evgeny"s;
+
+    // Пакетное сопоставление совпадает с сопоставлением по одному документу и сохраняет порядок id
+    const auto check_matches = [&]() {
+        const auto matches = server.MatchDocuments(query, document_ids);
+        ASSERT_EQUAL(matches.size(), document_ids.size());
+        ASSERT(matches == server.MatchDocuments(std::execution::seq, query, document_ids));
+        ASSERT(matches == server.MatchDocuments(std::execution::par, query, document_ids));
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            ASSERT(matches[i] == server.MatchDocument(query, document_ids[i]));
+            ASSERT(matches[i] == server.MatchDocument(std::execution::par, query, document_ids[i]));
+        }
+    };
+    check_matches();
+    const auto [words, status] = server.MatchDocument(query, 1);
+    ASSERT((words == std::vector<std::string_view>{ "cat"sv, "fluffy"sv, "tail"sv }));
+    ASSERT(std::get<0>(server.MatchDocument(query, 0)).empty());
+    ASSERT(server.MatchDocuments(query, {}).empty());
+
+    // Несуществующий id в пакете приводит к исключению
+    try {
+        server.MatchDocuments(std::execution::par, query, { 1, 100 });
+        ASSERT_HINT(false, "Несуществующий id должен приводить к исключению"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+
+    // Прямой индекс сохраняется при смене статуса, удалении, сжатии и в снимке
+    server.SetDocumentStatus(1, DocumentStatus::BANNED);
+    for (int id = 40; id < 50; ++id) {
+        server.RemoveDocument(id);
+    }
+    document_ids.erase(document_ids.begin(), document_ids.begin() + 10);
+    check_matches();
+    ASSERT(std::get<DocumentStatus>(server.MatchDocuments(query, { 1 })[0]) == DocumentStatus::BANNED);
+    ASSERT_EQUAL(server.GetWordFrequencies(1).at("fluffy"sv), 2.0 / 5);
+    server.Compact();
+    check_matches();
+    ASSERT_EQUAL(server.GetWordFrequencies(1).at("fluffy"sv), 2.0 / 5);
+
+    const std::string path = "search_server_match_test.snapshot"s;
+    server.SaveSnapshot(path);
+    const SearchServer restored_server = SearchServer::OpenSnapshot(path);
+    std::remove(path.c_str());
+    ASSERT(restored_server.MatchDocuments(query, document_ids) == server.MatchDocuments(query, document_ids));
+    for (const int document_id : document_ids) {
+        ASSERT(restored_server.GetWordFrequencies(document_id) == server.GetWordFrequencies(document_id));
+    }
+}
+
+void TestSearchPages() {
+    SearchServer server("and"s);
+    std::mt19937 generator(7);
+    for (int id = 0; id < 300; ++id) {
+        std::string text;
+        for (int word = 0; word < 4; ++word) {
+            text += "w"s + std::to_string(generator() % 12) + " "s;
+        }
+        // Одинаковые тексты дают равную релевантность, порядок решают рейтинг и id
+        const DocumentStatus status = id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id, id % 3 == 0 ? "w1 w2 w3 w4"s : text, status, { static_cast<int>(generator() % 3) });
+    }
+    const auto even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+
+    // Страницы, пройденные по курсору, в сумме дают полный результат поиска без пропусков и повторов
+    const auto check_pages = [](const std::vector<Document>& expected, size_t page_size, const auto& find_page) {
+        std::vector<Document> actual;
+        std::optional<SearchCursor> cursor;
+        do {
+            const SearchPage page = find_page(page_size, cursor);
+            ASSERT(page.size() <= page_size);
+            ASSERT(page.size() == page_size || !page.next);
+            actual.insert(actual.end(), page.begin(), page.end());
+            cursor = page.next;
+        } while (cursor);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT_EQUAL(actual[i].rating, expected[i].rating);
+            ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-12);
+        }
+    };
+    for (const std::string& query : { "w1 w2"s, "w3 -w4"s, "w0 w5 w7 w11"s, "w1"s, "missing"s }) {
+        const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000);
+        const auto expected_even = server.FindTopDocuments(query, even, 1000);
+        for (const size_t page_size : { 1u, 7u, 50u, 1000u }) {
+            check_pages(expected, page_size, [&](size_t size, const auto& after) {
+                return server.FindTopDocumentsPage(query, DocumentStatus::ACTUAL, size, after);
+                });
+            check_pages(expected, page_size, [&](size_t size, const auto& after) {
+                return server.FindTopDocumentsPage(std::execution::par, query, DocumentStatus::ACTUAL, size, after);
+                });
+            check_pages(expected, page_size, [&](size_t size, const auto& after) {
+                return server.FindTopDocumentsPage(dynamic_pruning, query, DocumentStatus::ACTUAL, size, after);
+                });
+            check_pages(expected_even, page_size, [&](size_t size, const auto& after) {
+                return server.FindTopDocumentsPage(query, even, size, after);
+                });
+            check_pages(expected_even, page_size, [&](size_t size, const auto& after) {
+                return server.FindTopDocumentsPage(dynamic_pruning, query, even, size, after);
+                });
+        }
+    }
+
+    // Страница разбивается функцией Paginate как вектор документов
+    const SearchPage page = server.FindTopDocumentsPage("w1 w2"s, DocumentStatus::ACTUAL, 5);
+    ASSERT(page.next.has_value());
+    ASSERT_EQUAL(Paginate(page, 2).size(), 3u);
+    ASSERT_EQUAL(page.next->id, page.documents.back().id);
+
+    try {
+        server.FindTopDocumentsPage("w1"s, DocumentStatus::ACTUAL, 0);
+        ASSERT_HINT(false, "Пустая страница должна приводить к исключению"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов 
 void TestSearchServer() { 
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent); 
@@ -281,6 +1685,31 @@ void TestSearchServer() {
     RUN_TEST(TestRelevanceCalculation); 
     RUN_TEST(TestRequestQueue); 
     RUN_TEST(TestRemoveDuplicates); 
+    RUN_TEST(TestRemoveDocument);
+    RUN_TEST(TestWordFrequencies);
+    RUN_TEST(TestTopDocumentsCount);
+    RUN_TEST(TestDynamicPruning);
+    RUN_TEST(TestParallelSearch);
+    RUN_TEST(TestConcurrentMap);
+    RUN_TEST(TestPostingList);
+    RUN_TEST(TestTokenizer);
+    RUN_TEST(TestDocumentText);
+    RUN_TEST(TestTermArena);
+    RUN_TEST(TestSnapshot);
+    RUN_TEST(TestAddDocuments);
+    RUN_TEST(TestIngestPipeline);
+    RUN_TEST(TestVersionedSearchServer);
+    RUN_TEST(TestTombstones);
+    RUN_TEST(TestInverseDocumentFreqs);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestProcessQueries);
+    RUN_TEST(TestQueryContext);
+    RUN_TEST(TestStatusPartitions);
+    RUN_TEST(TestDocumentColumns);
+    RUN_TEST(TestDuplicatePolicy);
+    RUN_TEST(TestNearDuplicates);
+    RUN_TEST(TestMatchDocumentBatch);
+    RUN_TEST(TestSearchPages);
 } 
  
 // --------- Окончание модульных тестов поисковой системы -----------
@@ -42,4 +42,29 @@ void TestStatusSearch();
 void TestRelevanceCalculation();
 void TestRequestQueue();
 void TestRemoveDuplicates();
+void TestRemoveDocument();
+void TestWordFrequencies();
+void TestTopDocumentsCount();
+void TestDynamicPruning();
+void TestParallelSearch();
+void TestConcurrentMap();
+void TestPostingList();
+void TestTokenizer();
+void TestDocumentText();
+void TestTermArena();
+void TestSnapshot();
+void TestAddDocuments();
+void TestIngestPipeline();
+void TestVersionedSearchServer();
+void TestTombstones();
+void TestInverseDocumentFreqs();
+void TestQueryCache();
+void TestProcessQueries();
+void TestQueryContext();
+void TestStatusPartitions();
+void TestDocumentColumns();
+void TestDuplicatePolicy();
+void TestNearDuplicates();
+void TestMatchDocumentBatch();
+void TestSearchPages();
 void TestSearchServer();
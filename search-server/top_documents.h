@@ -0,0 +1,76 @@
+#pragma once
+#include "document.h"
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <vector>
+
+constexpr double BORDER = 1e-6;
+
+// Order of search results: relevance, then rating, then id
+inline bool IsRankedHigher(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < BORDER) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Keeps the best max_count documents seen so far in a heap with the worst one on top
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t max_count)
+        : max_count_(max_count) {
+    }
+
+    // Keeps only documents ranked strictly below after, e.g. the ones following a result page
+    TopDocuments(size_t max_count, const Document* after)
+        : max_count_(max_count) {
+        if (after != nullptr) {
+            after_ = *after;
+        }
+    }
+
+    void Add(const Document& document) {
+        if (after_ && !IsRankedHigher(*after_, document)) {
+            return;
+        }
+        if (heap_.size() < max_count_) {
+            heap_.push_back(document);
+            std::push_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+        }
+        else if (max_count_ > 0 && IsRankedHigher(document, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+            heap_.back() = document;
+            std::push_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+        }
+    }
+
+    bool IsFull() const {
+        return heap_.size() >= max_count_;
+    }
+
+    // The document a newcomer has to outrank, valid only for a non-empty selection
+    const Document& GetWorst() const {
+        return heap_.front();
+    }
+
+    void Merge(const TopDocuments& other) {
+        for (const Document& document : other.heap_) {
+            Add(document);
+        }
+    }
+
+    // Returns the documents best first and leaves the selection empty
+    std::vector<Document> Extract() {
+        std::sort_heap(heap_.begin(), heap_.end(), IsRankedHigher);
+        return std::move(heap_);
+    }
+
+private:
+    size_t max_count_;
+    std::optional<Document> after_;
+    std::vector<Document> heap_;
+};
@@ -0,0 +1,162 @@
+#include "versioned_search_server.h"
+#include <exception>
+#include <thread>
+
+namespace {
+size_t GetReaderSlot(size_t slot_count) {
+    static thread_local const size_t slot = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    return slot % slot_count;
+}
+}
+
+VersionedSearchServer::ReadHandle::ReadHandle(const SearchServer& server, std::atomic<int64_t>& reader_count, uint64_t version)
+    : server_(&server)
+    , reader_count_(&reader_count)
+    , version_(version) {
+}
+
+VersionedSearchServer::ReadHandle::ReadHandle(ReadHandle&& other) noexcept
+    : server_(other.server_)
+    , reader_count_(other.reader_count_)
+    , version_(other.version_) {
+    other.reader_count_ = nullptr;
+}
+
+VersionedSearchServer::ReadHandle::~ReadHandle() {
+    if (reader_count_) {
+        reader_count_->fetch_sub(1);
+    }
+}
+
+VersionedSearchServer::VersionedSearchServer(const std::string_view stop_words_text, SearchServerOptions options)
+    : instances_{ SearchServer(stop_words_text, options), SearchServer(stop_words_text, options) } {
+}
+
+VersionedSearchServer::VersionedSearchServer(const std::function<SearchServer()>& make_instance)
+    : instances_{ make_instance(), make_instance() } {
+}
+
+VersionedSearchServer::~VersionedSearchServer() {
+    {
+        std::lock_guard guard(compactor_mutex_);
+        stopping_ = true;
+    }
+    compactor_wakeup_.notify_one();
+    if (compactor_.joinable()) {
+        compactor_.join();
+    }
+}
+
+VersionedSearchServer::ReadHandle VersionedSearchServer::Read() const {
+    const size_t slot = GetReaderSlot(READER_SLOT_COUNT);
+    uint64_t version = version_.load();
+    while (true) {
+        const size_t instance = version % 2;
+        std::atomic<int64_t>& reader_count = readers_[instance][slot].count;
+        reader_count.fetch_add(1);
+        // Once the instance is seen published after registering, the writer waits for this reader
+        const uint64_t current_version = version_.load();
+        if (current_version % 2 == instance) {
+            return ReadHandle(instances_[instance], reader_count, current_version);
+        }
+        reader_count.fetch_sub(1);
+        version = current_version;
+    }
+}
+
+uint64_t VersionedSearchServer::GetVersion() const {
+    return version_.load();
+}
+
+void VersionedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Update([&](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void VersionedSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    Update([&](SearchServer& server) {
+        server.AddDocuments(std::execution::par, documents);
+    });
+}
+
+void VersionedSearchServer::RemoveDocument(int document_id) {
+    Update([&](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void VersionedSearchServer::Update(const std::function<void(SearchServer&)>& update) {
+    std::unique_lock guard(update_mutex_);
+    const uint64_t version = version_.load();
+    const size_t published = version % 2;
+    const size_t unpublished = 1 - published;
+
+    // Readers never stay on the unpublished instance: the previous update waited for them
+    std::exception_ptr error;
+    try {
+        update(instances_[unpublished]);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    version_.store(version + 1);
+
+    WaitForReaders(published);
+    try {
+        update(instances_[published]);
+    }
+    catch (...) {
+        // A deterministic update fails on both instances alike, so only the first error is kept.
+        // A failure of the replay alone, e.g. std::bad_alloc, leaves the instances apart and is reported.
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+    const bool needs_compaction = instances_[published].NeedsCompaction();
+    guard.unlock();
+
+    if (needs_compaction) {
+        RequestCompaction();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void VersionedSearchServer::WaitForReaders(size_t instance) const {
+    for (const ReaderSlot& slot : readers_[instance]) {
+        while (slot.count.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void VersionedSearchServer::RequestCompaction() {
+    std::lock_guard guard(compactor_mutex_);
+    if (!compactor_.joinable()) {
+        compactor_ = std::thread([this]() {
+            RunCompactor();
+            });
+    }
+    compaction_requested_ = true;
+    compactor_wakeup_.notify_one();
+}
+
+void VersionedSearchServer::RunCompactor() {
+    std::unique_lock guard(compactor_mutex_);
+    while (true) {
+        compactor_wakeup_.wait(guard, [this]() {
+            return compaction_requested_ || stopping_;
+            });
+        if (stopping_) {
+            return;
+        }
+        compaction_requested_ = false;
+        guard.unlock();
+        Update([](SearchServer& server) {
+            server.Compact(std::execution::par);
+            });
+        guard.lock();
+    }
+}
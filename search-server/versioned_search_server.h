@@ -0,0 +1,99 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "search_server.h"
+
+// Search server that answers queries while it is being updated. Two instances of
+// the index are kept: readers pin the published one without taking locks, a writer
+// applies an update to the other one and publishes it, then waits until the readers
+// of the previous instance leave and replays the update there. Updates are applied
+// one at a time and must be deterministic; the index takes twice the memory.
+// When the servers do not compact on removal, compaction runs as an update on a
+// background thread once the thresholds are reached.
+class VersionedSearchServer {
+public:
+    // Keeps one instance of the index from being modified while the handle is alive
+    class ReadHandle {
+    public:
+        ReadHandle(ReadHandle&& other) noexcept;
+        ReadHandle& operator=(ReadHandle&&) = delete;
+        ~ReadHandle();
+
+        const SearchServer& operator*() const {
+            return *server_;
+        }
+
+        const SearchServer* operator->() const {
+            return server_;
+        }
+
+        // Number of updates published before the pinned instance
+        uint64_t GetVersion() const {
+            return version_;
+        }
+
+    private:
+        friend class VersionedSearchServer;
+
+        ReadHandle(const SearchServer& server, std::atomic<int64_t>& reader_count, uint64_t version);
+
+        const SearchServer* server_;
+        std::atomic<int64_t>* reader_count_;
+        uint64_t version_;
+    };
+
+    explicit VersionedSearchServer(const std::string_view stop_words_text, SearchServerOptions options = {});
+    // make_instance is called twice and must build identical servers, e.g. by opening the same snapshot
+    explicit VersionedSearchServer(const std::function<SearchServer()>& make_instance);
+
+    VersionedSearchServer(const VersionedSearchServer&) = delete;
+    VersionedSearchServer& operator=(const VersionedSearchServer&) = delete;
+    ~VersionedSearchServer();
+
+    // Never blocks. Updates wait for the handles of the instance they are about to
+    // modify, so handles should not outlive a request.
+    ReadHandle Read() const;
+
+    uint64_t GetVersion() const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void RemoveDocument(int document_id);
+
+    // Applies update to both instances and publishes the result as one version. If update
+    // throws, the changes it made before that are published and the exception is rethrown.
+    // An exception thrown only when the update is replayed on the other instance is rethrown
+    // too, the instances then differ.
+    void Update(const std::function<void(SearchServer&)>& update);
+
+private:
+    static constexpr size_t READER_SLOT_COUNT = 16;
+
+    // Readers on different threads count themselves in different cache lines
+    struct alignas(64) ReaderSlot {
+        std::atomic<int64_t> count{ 0 };
+    };
+
+    std::array<SearchServer, 2> instances_;
+    mutable std::array<std::array<ReaderSlot, READER_SLOT_COUNT>, 2> readers_;
+    // Readers are served by instances_[version_ % 2]
+    std::atomic<uint64_t> version_{ 0 };
+    std::mutex update_mutex_;
+
+    std::thread compactor_;
+    std::mutex compactor_mutex_;
+    std::condition_variable compactor_wakeup_;
+    bool compaction_requested_ = false;
+    bool stopping_ = false;
+
+    void WaitForReaders(size_t instance) const;
+    void RequestCompaction();
+    void RunCompactor();
+};